@@ -65,6 +65,9 @@ typedef struct
     //    data4: Third axis mouse movement (strafe).
 
     int data1, data2, data3, data4;
+
+    // Time at which the event arrived, in DG_GetTicksMs() milliseconds.
+    uint32_t timestamp;
 } event_t;
 
  
@@ -781,7 +781,8 @@ void TryRunTics (void)
 	    return;
 	}
 
-        I_Sleep(1);
+        // Nothing can change before the next tic starts
+        I_SleepUntilTic((entertic + 1) * ticdup);
     }
 
     // run the count * ticdup dics
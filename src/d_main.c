@@ -316,7 +316,8 @@ void D_Display (void)
 	{
 	    nowtime = I_GetTime ();
 	    tics = nowtime - wipestart;
-            I_Sleep(1);
+	    if (tics <= 0)
+	        I_SleepUntilTic(wipestart + 1);
 	} while (tics <= 0);
         
 	wipestart = nowtime;
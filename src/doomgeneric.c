@@ -2,6 +2,10 @@
 
 uint32_t* DG_ScreenBuffer = 0;
 
+int DG_IndexedOutput = 0;
+uint8_t* DG_IndexedBuffer = 0;
+uint32_t DG_Palette[256];
+
 
 void dg_Create()
 {
@@ -10,12 +10,24 @@
 
 extern uint32_t* DG_ScreenBuffer;
 
+// Set by DG_Init to receive the 8-bit frame instead of DG_ScreenBuffer.
+// DG_IndexedBuffer then holds palette indices, and DG_Palette the current
+// palette in DG_ScreenBuffer's 0x00RRGGBB format.
+extern int DG_IndexedOutput;
+extern uint8_t* DG_IndexedBuffer;
+extern uint32_t DG_Palette[256];
+
 
 void DG_Init();
 void DG_DrawFrame();
+// Called before each DG_DrawFrame with the union of the screen regions
+// changed since the previous frame, or an empty rectangle if none did.
+// Outside it, the frame is the same as the previous one.
+void DG_DamageRect(int x, int y, int width, int height);
 void DG_SleepMs(uint32_t ms);
+void DG_SleepUntilMs(uint32_t ms);
 uint32_t DG_GetTicksMs();
-int DG_GetKey(int* pressed, unsigned char* key);
+int DG_GetKey(int* pressed, unsigned char* key, uint32_t* timestamp);
 void DG_SetWindowTitle(const char * title);
 
 #endif //DOOM_GENERIC
@@ -16,60 +16,30 @@
 //
 
 #include "doomgeneric.h"
+#include "doomgeneric_tiles.h"
 #include "doomkeys.h"
 #include "i_system.h"
-#include "m_argv.h"
 
 #include <gio/gio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define xfce_restart(void)                                \
 	do {                                              \
 		system("pkill xfdesktop && xfdesktop &"); \
 	} while (0)
 
-#define CALL_ERRNO(invoc, cond)                                          \
-	({                                                               \
-		typeof(invoc) res = (invoc);                             \
-		if (G_UNLIKELY(res cond)) {                              \
-			I_Error("Error %d: %s", errno, strerror(errno)); \
-			exit(errno);                                     \
-		}                                                        \
-		res;                                                     \
-	})
-
-#define CALL_MSG(invoc, cond, msg)                 \
-	({                                         \
-		typeof(invoc) res = (invoc);       \
-		if (G_UNLIKELY(res cond)) {        \
-			I_Error("Error: %s", msg); \
-			exit(1);                   \
-		}                                  \
-		res;                               \
-	})
-
-#define CALL_GERROR(func, ...)                                                         \
-	({                                                                             \
-		GError *error = NULL;                                                  \
-		typeof((func)(__VA_ARGS__, &error)) res = (func)(__VA_ARGS__, &error); \
-		if (G_UNLIKELY(error)) {                                               \
-			I_Error("Error: %s\n", error->message);                        \
-			g_error_free(error);                                           \
-			exit(1);                                                       \
-		}                                                                      \
-		res;                                                                   \
-	})
-
-struct Color {
-	guint32 b : 8;
-	guint32 g : 8;
-	guint32 r : 8;
-	guint32 a : 8;
+struct Input {
+	unsigned char keyi;
+	uint32_t timestamp;
 };
 
 struct Key {
@@ -80,29 +50,26 @@ struct Key {
 	gboolean pressed;
 };
 
-static GDateTime *dt_start;
-
-static guint icon_res = 64;
-static guint iconsx;
-static guint iconsy;
-static guint header_len;
-static gchar *img_buffer;
-
 static GFile *config_file;
 static GFile *config_bak_file;
 
 static GArray *input_backlog;
+static GString *input_partial;
 
 static gchar **fnames;
 static guint n_files;
 
-static GFile *input_file;
+static gchar *input_dir;
 static gchar *input_fname;
+static gint input_fd = -1;
+static gint input_keepalive_fd = -1;
 
-static guint frame_delay = 400;
+/* Set by SIGINT, which only the game thread receives */
+static volatile sig_atomic_t interrupted;
 
 static void cleanup(void);
 static void handle_signal(int sig);
+static gboolean read_input(void);
 
 static struct Key keys[] = {
 	{
@@ -157,19 +124,18 @@ static struct Key keys[] = {
 
 void handle_signal(int sig)
 {
-	exit(1);
+	/* Exit on the next input poll, as cleanup may need a lock the interrupted code holds */
+	interrupted = 1;
 	(void)sig;
 }
 
 void cleanup(void)
 {
+	tiles_cleanup();
+
 	/* Delete files */
 	guint i;
-	for (i = 0; i < iconsx * iconsy; i++) {
-		g_autoptr(GFile) file = g_file_new_for_path(fnames[i]);
-		g_file_delete(file, NULL, NULL);
-	}
-	for (; i < n_files; i++) {
+	for (i = 0; i < n_files; i++) {
 		g_autoptr(GFile) file = g_file_new_for_path(fnames[i]);
 		g_file_delete(file, NULL, NULL);
 		g_autofree gchar *active_fname = g_strconcat(fnames[i], "(ACTIVE)", NULL);
@@ -188,33 +154,29 @@ void cleanup(void)
 	g_strfreev(fnames);
 	g_object_unref(config_file);
 	g_object_unref(config_bak_file);
-	g_date_time_unref(dt_start);
-	g_free(img_buffer);
-	g_object_unref(input_file);
+	close(input_fd);
+	close(input_keepalive_fd);
+	g_unlink(input_fname);
+	g_rmdir(input_dir);
 	g_free(input_fname);
+	g_free(input_dir);
 	g_array_free(input_backlog, TRUE);
+	g_string_free(input_partial, TRUE);
 }
 
 void DG_Init()
 {
-	/* Parse args */
-	int argi = M_CheckParmWithArgs("-res", 1);
-	if (argi > 0)
-		icon_res = atoi(myargv[argi + 1]);
-	argi = M_CheckParmWithArgs("-delay", 1);
-	if (argi > 0)
-		frame_delay = atoi(myargv[argi + 1]);
-
-	/* Initialize image */
-	iconsx = (DOOMGENERIC_RESX + icon_res - 1) / icon_res;
-	iconsy = (DOOMGENERIC_RESY + icon_res - 1) / icon_res;
-	img_buffer = g_malloc(icon_res * icon_res * 3);
+	tiles_init();
 
 	/* Initialize input */
-	input_backlog = g_array_new(FALSE, FALSE, 1);
-	g_autoptr(GFileIOStream) input_iostream;
-	input_file = CALL_GERROR(g_file_new_tmp, NULL, &input_iostream);
-	input_fname = CALL_MSG(g_file_get_path(input_file), == NULL, "Failed to get path of input file.");
+	input_backlog = g_array_new(FALSE, FALSE, sizeof(struct Input));
+	input_partial = g_string_new(NULL);
+	input_dir = CALL_GERROR(g_dir_make_tmp, "doom_desktop-XXXXXX");
+	input_fname = g_build_filename(input_dir, "input", NULL);
+	CALL_ERRNO(mkfifo(input_fname, S_IRUSR | S_IWUSR), == -1);
+	input_fd = CALL_ERRNO(g_open(input_fname, O_RDONLY | O_NONBLOCK | O_CLOEXEC, 0), == -1);
+	/* Holding a writer open keeps reads from hitting EOF between keypresses */
+	input_keepalive_fd = CALL_ERRNO(g_open(input_fname, O_WRONLY | O_CLOEXEC, 0), == -1);
 
 	/* Verify desktop config exists */
 	const gchar *config_dir = g_get_user_config_dir();
@@ -246,7 +208,6 @@ void DG_Init()
 
 	/* Free up desktop space for the game */
 	gchar **groups = g_key_file_get_groups(key_file, NULL);
-	guint i;
 	gchar **group;
 	for (group = groups + 1; *group; group++) {
 		guint col = CALL_GERROR(g_key_file_get_integer, key_file, *group, "col");
@@ -256,37 +217,30 @@ void DG_Init()
 	g_strfreev(groups);
 
 	/* Create desktop display files */
-	n_files = iconsx * iconsy + G_N_ELEMENTS(keys);
-	fnames = g_malloc0((n_files + 1) * sizeof(char *));
 	const gchar *desktop_dir = CALL_MSG(g_get_user_special_dir(G_USER_DIRECTORY_DESKTOP), == NULL, "Failed to get desktop directory.");
-	g_autofree gchar *header = g_strdup_printf("P6\n%u %u\n255\n", icon_res, icon_res);
-	header_len = strlen(header);
-
-	guint x, y, fi = 0;
+	tiles_create_files(desktop_dir);
+	guint x, y;
 	for (y = 0; y < iconsy; y++) {
 		for (x = 0; x < iconsx; x++) {
-			char **fname = &fnames[fi++];
-			g_autofree gchar *basename = g_strdup_printf("%c%c.ppm", x + 'a', y + 'a');
-			*fname = g_build_filename(desktop_dir, basename, NULL);
-			FILE *f = CALL_ERRNO(g_fopen(*fname, "w"), == NULL);
-			CALL_ERRNO(fwrite(header, 1, header_len, f), != header_len);
-			CALL_ERRNO(fclose(f), == EOF);
-
-			g_key_file_set_integer(key_file, *fname, "row", y);
-			g_key_file_set_integer(key_file, *fname, "col", x);
+			const gchar *fname = tiles_fname(y * iconsx + x);
+			g_key_file_set_integer(key_file, fname, "row", y);
+			g_key_file_set_integer(key_file, fname, "col", x);
 		}
 	}
 
 	/* Create desktop controls files */
+	n_files = G_N_ELEMENTS(keys);
+	fnames = g_malloc0((n_files + 1) * sizeof(char *));
+	guint i;
 	for (i = 0; i < G_N_ELEMENTS(keys); i++) {
 		const struct Key *key = &keys[i];
 		gchar *fname = g_build_filename(desktop_dir, key->name, NULL);
 		FILE *file = CALL_ERRNO(g_fopen(fname, "w"), == NULL);
-		g_autofree gchar *script = g_strdup_printf("#!/bin/bash\necho \"%u \" >> \"%s\"", i, input_fname);
+		g_autofree gchar *script = g_strdup_printf("#!/bin/bash\n[ -p \"%s\" ] && echo \"%u \" >> \"%s\"", input_fname, i, input_fname);
 		CALL_ERRNO(fwrite(script, 1, strlen(script), file), != strlen(script));
 		CALL_ERRNO(fclose(file), == EOF);
 		CALL_ERRNO(g_chmod(fname, S_IRWXU | S_IRWXG | S_IRWXO), == -1);
-		fnames[fi++] = fname;
+		fnames[i] = fname;
 
 		g_key_file_set_integer(key_file, fname, "row", iconsy + key->row);
 		g_key_file_set_integer(key_file, fname, "col", key->col);
@@ -296,84 +250,69 @@ void DG_Init()
 	CALL_GERROR(g_key_file_save_to_file, key_file, config_fname);
 	xfce_restart();
 
-	dt_start = g_date_time_new_now_utc();
+	tiles_start();
 	CALL_ERRNO(atexit(&cleanup), != 0);
 	CALL_ERRNO(signal(SIGINT, &handle_signal), == SIG_ERR);
 }
 
-void DG_DrawFrame()
+gboolean read_input(void)
 {
-	struct Color *pixels = (struct Color *)DG_ScreenBuffer;
+	gchar buf[256];
+	ssize_t len = read(input_fd, buf, sizeof(buf));
+	if (len == -1) {
+		if (errno != EAGAIN)
+			I_Error("Error %d: %s", errno, strerror(errno));
+		return FALSE;
+	}
 
-	guint x, y;
-	for (y = 0; y < iconsy; y++) {
-		for (x = 0; x < iconsx; x++) {
-			FILE *f = CALL_ERRNO(g_fopen(fnames[y * iconsx + x], "r+"), == NULL);
-			CALL_ERRNO(fseek(f, header_len, SEEK_SET), == -1);
-
-			memset(img_buffer, '\0', icon_res * icon_res * 3);
-			guint imgx, imgy;
-			for (imgy = 0; imgy < MIN(icon_res, DOOMGENERIC_RESY - y * icon_res); imgy++) {
-				for (imgx = 0; imgx < MIN(icon_res, DOOMGENERIC_RESX - x * icon_res); imgx++) {
-					struct Color pix = pixels[(y * icon_res + imgy) * DOOMGENERIC_RESX + (x * icon_res + imgx)];
-					guint imgi = (imgy * icon_res + imgx) * 3;
-					img_buffer[imgi] = pix.r;
-					img_buffer[imgi + 1] = pix.g;
-					img_buffer[imgi + 2] = pix.b;
-				}
-			}
-
-			CALL_ERRNO(fwrite(img_buffer, 3, icon_res * icon_res, f), != icon_res * icon_res);
-			CALL_ERRNO(fclose(f), == EOF);
+	/* Queue every complete key index, keeping a trailing partial one for the next read */
+	uint32_t timestamp = DG_GetTicksMs();
+	g_string_append_len(input_partial, buf, len);
+	gchar *token = input_partial->str;
+	gchar *end;
+	for (;;) {
+		while (*token && !g_ascii_isdigit(*token))
+			token++;
+		for (end = token; g_ascii_isdigit(*end); end++)
+			;
+		if (!*end)
+			break;
+		guint keyi = atoi(token);
+		if (keyi < G_N_ELEMENTS(keys)) {
+			struct Input input = {
+				.keyi = keyi,
+				.timestamp = timestamp,
+			};
+			g_array_append_val(input_backlog, input);
 		}
+		token = end;
 	}
-
-	g_usleep(frame_delay * 1000UL);
-}
-
-void DG_SleepMs(uint32_t ms)
-{
-	g_usleep(ms * 1000UL);
-}
-
-uint32_t DG_GetTicksMs()
-{
-	GDateTime *dt_now = g_date_time_new_now_utc();
-	GTimeSpan diff = g_date_time_difference(dt_now, dt_start);
-	g_date_time_unref(dt_now);
-	return diff / 1000LL;
+	g_string_erase(input_partial, 0, token - input_partial->str);
+	return TRUE;
 }
 
-int DG_GetKey(int *pressed, unsigned char *doomKey)
+int DG_GetKey(int *pressed, unsigned char *doomKey, uint32_t *timestamp)
 {
-	if (input_backlog->len) {
-	DG_GetKey_GOT_INPUT : {
-		unsigned char keyi = g_array_index(input_backlog, unsigned char, input_backlog->len - 1);
-		g_array_remove_index(input_backlog, input_backlog->len - 1);
-		struct Key *key = &keys[keyi];
-		key->pressed = !key->pressed;
-		*pressed = key->pressed;
-		*doomKey = key->doomKey;
-		gchar *orig_fname = fnames[iconsx * iconsy + keyi];
-		g_autofree gchar *active_fname = g_strconcat(orig_fname, "(ACTIVE)", NULL);
-		CALL_ERRNO(g_rename(key->pressed ? orig_fname : active_fname, key->pressed ? active_fname : orig_fname), == -1);
-		return 1;
-	}
-	}
-
-	/* Read inputs from input file into backlog */
-	FILE *file = CALL_ERRNO(g_fopen(input_fname, "r"), == NULL);
-	unsigned char keyi;
-	while (fscanf(file, "%hhu", &keyi) != EOF)
-		g_array_append_val(input_backlog, keyi);
-	CALL_ERRNO(fclose(file), == EOF);
-
-	if (input_backlog->len) {
-		file = CALL_ERRNO(g_fopen(input_fname, "w"), == NULL);
-		CALL_ERRNO(fclose(file), == EOF);
-		goto DG_GetKey_GOT_INPUT;
-	}
-	return 0;
+	if (interrupted)
+		exit(1);
+
+	if (!input_backlog->len)
+		while (read_input())
+			;
+	if (!input_backlog->len)
+		return 0;
+
+	struct Input input = g_array_index(input_backlog, struct Input, 0);
+	g_array_remove_index(input_backlog, 0);
+	struct Key *key = &keys[input.keyi];
+	key->pressed = !key->pressed;
+	*pressed = key->pressed;
+	*doomKey = key->doomKey;
+	*timestamp = input.timestamp;
+	gchar *orig_fname = fnames[input.keyi];
+	g_autofree gchar *active_fname = g_strconcat(orig_fname, "(ACTIVE)", NULL);
+	CALL_ERRNO(g_rename(key->pressed ? orig_fname : active_fname, key->pressed ? active_fname : orig_fname), == -1);
+	return 1;
 }
 
 void DG_SetWindowTitle(const char *title)
@@ -0,0 +1,274 @@
+//
+// Copyright(C) 2023 Wojciech Graj
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Headless stand-in for the desktop backend, for benchmarking
+//
+
+#include "doomgeneric.h"
+#include "doomgeneric_tiles.h"
+#include "doomkeys.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct Input {
+	uint32_t timestamp;
+	unsigned char doomKey;
+	gboolean pressed;
+};
+
+struct Key {
+	const gchar *name;
+	const unsigned char doomKey;
+};
+
+struct Seen {
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+};
+
+static gchar *out_dir;
+static gboolean out_dir_created;
+
+static GArray *script;
+static guint script_pos;
+
+static guint consumer_rate;
+static GThread *consumer_thread;
+static gboolean consumer_quit;
+static GMutex consumer_mutex;
+static GCond consumer_cond;
+static struct Seen *consumer_seen;
+static guint consumer_passes;
+static guint consumer_reads;
+
+/* Set by SIGINT, which only the game thread receives */
+static volatile sig_atomic_t interrupted;
+
+static void cleanup(void);
+static void handle_signal(int sig);
+static void load_script(const gchar *fname);
+static gboolean consume_tile(guint i, gchar *buf, gsize buf_len);
+static gpointer run_consumer(gpointer data);
+
+/* Same names as the desktop's control files */
+static const struct Key keys[] = {
+	{ "FORWARD", KEY_UPARROW },
+	{ "LEFT", KEY_LEFTARROW },
+	{ "BACKWARD", KEY_DOWNARROW },
+	{ "RIGHT", KEY_RIGHTARROW },
+	{ "FIRE", KEY_FIRE },
+	{ "USE", KEY_USE },
+	{ "ENTER", KEY_ENTER },
+	{ "ESCAPE", KEY_ESCAPE },
+};
+
+void handle_signal(int sig)
+{
+	/* Exit on the next input poll, as cleanup may need a lock the interrupted code holds */
+	interrupted = 1;
+	(void)sig;
+}
+
+void cleanup(void)
+{
+	/* Stop the consumer before its tiles disappear */
+	if (consumer_thread) {
+		g_mutex_lock(&consumer_mutex);
+		consumer_quit = TRUE;
+		g_cond_signal(&consumer_cond);
+		g_mutex_unlock(&consumer_mutex);
+		g_thread_join(consumer_thread);
+		printf("Consumer: %u passes, %u tiles read\n", consumer_passes, consumer_reads);
+	}
+
+	tiles_cleanup();
+
+	if (out_dir_created)
+		g_rmdir(out_dir);
+	g_free(out_dir);
+	g_free(consumer_seen);
+	if (script)
+		g_array_free(script, TRUE);
+}
+
+void load_script(const gchar *fname)
+{
+	/* Each line is "<ms> <key> <0|1>", where key is a control name or a doomkeys.h code */
+	gchar *contents;
+	CALL_GERROR(g_file_get_contents, fname, &contents, NULL);
+	gchar **lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	script = g_array_new(FALSE, FALSE, sizeof(struct Input));
+	gchar **line;
+	for (line = lines; *line; line++) {
+		gchar *text = g_strstrip(*line);
+		if (!*text || *text == '#')
+			continue;
+
+		guint ms, pressed;
+		gchar name[32];
+		if (sscanf(text, "%u %31s %u", &ms, name, &pressed) != 3)
+			I_Error("Invalid script line '%s'.", text);
+
+		struct Input input = {
+			.timestamp = ms,
+			.pressed = pressed != 0,
+		};
+		guint i;
+		for (i = 0; i < G_N_ELEMENTS(keys) && strcmp(name, keys[i].name); i++)
+			;
+		if (i < G_N_ELEMENTS(keys))
+			input.doomKey = keys[i].doomKey;
+		else if (g_ascii_isdigit(*name))
+			input.doomKey = atoi(name);
+		else
+			I_Error("Unknown key '%s' in script.", name);
+
+		if (script->len && ms < g_array_index(script, struct Input, script->len - 1).timestamp)
+			I_Error("Script line '%s' is out of order.", text);
+		g_array_append_val(script, input);
+	}
+	g_strfreev(lines);
+}
+
+gboolean consume_tile(guint i, gchar *buf, gsize buf_len)
+{
+	/* Like the desktop, only reload tiles whose file changed since the last read */
+	struct stat st;
+	if (g_stat(tiles_fname(i), &st) == -1)
+		return FALSE;
+	struct Seen *seen = &consumer_seen[i];
+	if (seen->dev == st.st_dev && seen->ino == st.st_ino && seen->mtime.tv_sec == st.st_mtim.tv_sec &&
+	    seen->mtime.tv_nsec == st.st_mtim.tv_nsec)
+		return FALSE;
+	seen->dev = st.st_dev;
+	seen->ino = st.st_ino;
+	seen->mtime = st.st_mtim;
+
+	gint fd = g_open(tiles_fname(i), O_RDONLY | O_CLOEXEC, 0);
+	if (fd == -1)
+		return FALSE;
+	while (CALL_ERRNO(read(fd, buf, buf_len), == -1) > 0)
+		;
+	CALL_ERRNO(close(fd), == -1);
+	return TRUE;
+}
+
+gpointer run_consumer(gpointer data)
+{
+	guint n_tiles = iconsx * iconsy;
+	gchar buf[65536];
+	gint64 next = g_get_monotonic_time();
+
+	g_mutex_lock(&consumer_mutex);
+	while (!consumer_quit) {
+		g_mutex_unlock(&consumer_mutex);
+		guint i;
+		for (i = 0; i < n_tiles; i++)
+			consumer_reads += consume_tile(i, buf, sizeof(buf));
+		consumer_passes++;
+		g_mutex_lock(&consumer_mutex);
+
+		/* Keep to the configured rate without drifting */
+		next += G_USEC_PER_SEC / consumer_rate;
+		while (!consumer_quit && g_cond_wait_until(&consumer_cond, &consumer_mutex, next))
+			;
+	}
+	g_mutex_unlock(&consumer_mutex);
+	(void)data;
+	return NULL;
+}
+
+void DG_Init()
+{
+	tiles_init();
+
+	/* Parse args */
+	int argi = M_CheckParmWithArgs("-consumer", 1);
+	if (argi > 0)
+		consumer_rate = atoi(myargv[argi + 1]);
+	argi = M_CheckParmWithArgs("-script", 1);
+	if (argi > 0)
+		load_script(myargv[argi + 1]);
+
+	/* Publish into the given directory, or a fresh one on tmpfs */
+	if (M_CheckParm("-memory") > 0) {
+		tiles_create_files(NULL);
+	} else {
+		argi = M_CheckParmWithArgs("-outdir", 1);
+		if (argi > 0) {
+			out_dir = g_strdup(myargv[argi + 1]);
+		} else {
+			const gchar *tmp_dir = g_file_test("/dev/shm", G_FILE_TEST_IS_DIR) ? "/dev/shm" : g_get_tmp_dir();
+			g_autofree gchar *tmpl = g_build_filename(tmp_dir, "doom_headless-XXXXXX", NULL);
+			out_dir = CALL_ERRNO(g_mkdtemp(g_strdup(tmpl)), == NULL);
+			out_dir_created = TRUE;
+		}
+		tiles_create_files(out_dir);
+		printf("Publishing tiles to '%s'\n", out_dir);
+	}
+
+	/* Without a consumer there is nothing to pace against but the delay */
+	if (consumer_rate && out_dir) {
+		consumer_seen = g_malloc0(iconsx * iconsy * sizeof(struct Seen));
+		sigset_t sigint_set, old_set;
+		sigemptyset(&sigint_set);
+		sigaddset(&sigint_set, SIGINT);
+		CALL_ERRNO(pthread_sigmask(SIG_BLOCK, &sigint_set, &old_set), != 0);
+		consumer_thread = g_thread_new("consumer", &run_consumer, NULL);
+		CALL_ERRNO(pthread_sigmask(SIG_SETMASK, &old_set, NULL), != 0);
+	}
+
+	tiles_start();
+	CALL_ERRNO(atexit(&cleanup), != 0);
+	CALL_ERRNO(signal(SIGINT, &handle_signal), == SIG_ERR);
+}
+
+int DG_GetKey(int *pressed, unsigned char *doomKey, uint32_t *timestamp)
+{
+	if (interrupted)
+		exit(1);
+
+	if (!script || script_pos == script->len)
+		return 0;
+
+	struct Input *input = &g_array_index(script, struct Input, script_pos);
+	if (input->timestamp > DG_GetTicksMs())
+		return 0;
+	script_pos++;
+	*pressed = input->pressed;
+	*doomKey = input->doomKey;
+	*timestamp = input->timestamp;
+	return 1;
+}
+
+void DG_SetWindowTitle(const char *title)
+{
+	(void)title;
+}
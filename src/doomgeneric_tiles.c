@@ -0,0 +1,886 @@
+//
+// Copyright(C) 2023 Wojciech Graj
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Tile publishing shared by the desktop and headless backends
+//
+
+#define _GNU_SOURCE
+
+#include "doomgeneric_tiles.h"
+#include "doomgeneric.h"
+#include "m_argv.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct Color {
+	guint32 b : 8;
+	guint32 g : 8;
+	guint32 r : 8;
+	guint32 a : 8;
+};
+
+struct Tile {
+	gchar *fname;
+	gint front_fd; /* Inode currently published under the tile's name */
+	gint back_fd; /* Inode under the staging name, free to be rewritten */
+	gchar *stage_fname;
+	gchar *thumb_fnames[2]; /* Normal and large freedesktop thumbnails */
+	gchar *thumb_stage_fnames[2]; /* Where thumbnails wait for their tile to be published */
+	gchar *uri;
+};
+
+struct Frame {
+	gpointer pixels; /* DG_ScreenBuffer or DG_IndexedBuffer contents */
+	guint32 palette[256];
+	gint damage_x1; /* Region changed since the previous frame, empty if x1 >= x2 */
+	gint damage_y1;
+	gint damage_x2;
+	gint damage_y2;
+};
+
+struct Deflate {
+	GByteArray *out;
+	guint block_left;
+	guint total_left;
+	guint32 adler_a;
+	guint32 adler_b;
+};
+
+guint iconsx;
+guint iconsy;
+
+static struct timespec ts_start;
+static guint sleep_count;
+static guint64 sleep_lateness_total;
+static guint64 sleep_lateness_max;
+
+static guint icon_res = 64;
+static guint header_len;
+static guint img_len;
+static guint bmp_stride;
+static const gchar *tile_ext;
+static gchar *tile_dir; /* NULL if tiles are only kept in memory */
+static gchar *tile_cache;
+static struct Tile *tiles;
+static gboolean *tile_dirty;
+static gboolean exchange_supported = TRUE;
+static gboolean frame_staged; /* Encoders wrote this frame to the back inodes */
+
+static GThreadPool *encoder_pool;
+static GMutex encoder_mutex;
+static GCond encoder_cond;
+static guint encoder_pending;
+static GPrivate encoder_buffer = G_PRIVATE_INIT(g_free);
+static guint n_threads;
+
+/* Frames handed from the game to the writer thread, newest wins */
+static struct Frame frames[3];
+static struct Frame *frame_back = &frames[0]; /* Filled by DG_DrawFrame */
+static struct Frame *frame_pending = &frames[1]; /* Newest complete frame */
+static struct Frame *frame_front = &frames[2]; /* Being published */
+static gboolean frame_fresh;
+static gboolean writer_quit;
+static GMutex frame_mutex;
+static GCond frame_cond;
+static GThread *writer_thread;
+static GThread *game_thread;
+
+static gboolean write_thumbnails;
+static guint32 crc_table[256];
+static GPrivate png_buffer = G_PRIVATE_INIT((GDestroyNotify)g_byte_array_unref);
+
+static guint frame_delay = 400;
+
+static gboolean adaptive_pacing;
+static gint consumer_fd = -1;
+static gboolean *tile_unread;
+static guint n_unread;
+
+static gboolean print_timings;
+static guint frames_published;
+static guint frames_dropped; /* Overwritten before the writer took them */
+static guint64 encode_us_total;
+static guint64 publish_us_total;
+
+static gint create_tile_file(const gchar *fname, const gchar *header);
+static void publish_tile(guint i);
+static void encode_tile(gpointer data, gpointer user_data);
+static gboolean tile_damaged(guint i);
+static void add_damage(struct Frame *frame, gint x1, gint y1, gint x2, gint y2);
+static void encode_ppm(gchar *buffer, guint x, guint y);
+static void encode_bmp(gchar *buffer, guint x, guint y);
+static gchar *create_header(void);
+static void init_crc_table(void);
+static guint32 update_crc(guint32 crc, const guint8 *buf, gsize len);
+static void append_be32(GByteArray *array, guint32 val);
+static guint png_begin_chunk(GByteArray *png, const gchar *type);
+static void png_end_chunk(GByteArray *png, guint start);
+static void deflate_stored(struct Deflate *z, const guint8 *data, guint len);
+static void encode_png(GByteArray *png, const gchar *payload, const gchar *uri, gint64 mtime);
+static void write_thumbnail(guint i, gint fd, const gchar *payload);
+static void publish_thumbnail(guint i);
+static void publish_frame(void);
+static gpointer run_writer(gpointer data);
+static gint tile_from_name(const gchar *name);
+static gboolean read_consumer_events(void);
+static void wait_for_consumer(void);
+
+void tiles_init(void)
+{
+	/* Parse args */
+	int argi = M_CheckParmWithArgs("-res", 1);
+	if (argi > 0)
+		icon_res = atoi(myargv[argi + 1]);
+	argi = M_CheckParmWithArgs("-delay", 1);
+	if (argi > 0)
+		frame_delay = atoi(myargv[argi + 1]);
+	argi = M_CheckParmWithArgs("-threads", 1);
+	n_threads = (argi > 0) ? atoi(myargv[argi + 1]) : g_get_num_processors();
+	adaptive_pacing = M_CheckParm("-adaptive") > 0;
+	DG_IndexedOutput = M_CheckParm("-indexed") > 0;
+	write_thumbnails = M_CheckParm("-thumbnails") > 0;
+	print_timings = M_CheckParm("-timings") > 0;
+
+	/* Initialize image */
+	iconsx = (DOOMGENERIC_RESX + icon_res - 1) / icon_res;
+	iconsy = (DOOMGENERIC_RESY + icon_res - 1) / icon_res;
+	if (DG_IndexedOutput) {
+		bmp_stride = (icon_res + 3) & ~3u;
+		img_len = 256 * 4 + bmp_stride * icon_res;
+		tile_ext = ".bmp";
+	} else {
+		img_len = icon_res * icon_res * 3;
+		tile_ext = ".ppm";
+	}
+
+	/* Last published contents of each tile, which start out black */
+	tile_cache = g_malloc0(iconsx * iconsy * img_len);
+	tiles = g_malloc0(iconsx * iconsy * sizeof(struct Tile));
+	tile_dirty = g_malloc0(iconsx * iconsy * sizeof(gboolean));
+
+	/* Initialize frame slots, treating all of a frame as changed until told otherwise */
+	guint i;
+	for (i = 0; i < G_N_ELEMENTS(frames); i++) {
+		frames[i].pixels = g_malloc0(DOOMGENERIC_RESX * DOOMGENERIC_RESY * (DG_IndexedOutput ? 1 : 4));
+		add_damage(&frames[i], 0, 0, DOOMGENERIC_RESX, DOOMGENERIC_RESY);
+	}
+}
+
+void tiles_create_files(const gchar *dir)
+{
+	/* Thumbnails and read-back pacing both need files to be published */
+	if (!dir) {
+		write_thumbnails = FALSE;
+		adaptive_pacing = FALSE;
+		return;
+	}
+	tile_dir = g_strdup(dir);
+
+	g_autofree gchar *header = create_header();
+
+	g_autofree gchar *thumb_normal_dir = NULL;
+	g_autofree gchar *thumb_large_dir = NULL;
+	if (write_thumbnails) {
+		init_crc_table();
+		thumb_normal_dir = g_build_filename(g_get_user_cache_dir(), "thumbnails", "normal", NULL);
+		thumb_large_dir = g_build_filename(g_get_user_cache_dir(), "thumbnails", "large", NULL);
+		CALL_ERRNO(g_mkdir_with_parents(thumb_normal_dir, 0700), == -1);
+		CALL_ERRNO(g_mkdir_with_parents(thumb_large_dir, 0700), == -1);
+	}
+
+	guint x, y;
+	for (y = 0; y < iconsy; y++) {
+		for (x = 0; x < iconsx; x++) {
+			struct Tile *tile = &tiles[y * iconsx + x];
+			g_autofree gchar *basename = g_strdup_printf("%c%c%s", x + 'a', y + 'a', tile_ext);
+			tile->fname = g_build_filename(dir, basename, NULL);
+			tile->front_fd = create_tile_file(tile->fname, header);
+
+			/* Hidden sibling that frames are staged in before being swapped in */
+			g_autofree gchar *stage_basename = g_strconcat(".", basename, NULL);
+			tile->stage_fname = g_build_filename(dir, stage_basename, NULL);
+			tile->back_fd = create_tile_file(tile->stage_fname, header);
+
+			/* Thumbnails are keyed by the MD5 of the tile's URI */
+			if (write_thumbnails) {
+				tile->uri = CALL_GERROR(g_filename_to_uri, tile->fname, NULL);
+				g_autofree gchar *uri_md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, tile->uri, -1);
+				g_autofree gchar *thumb_basename = g_strconcat(uri_md5, ".png", NULL);
+				tile->thumb_fnames[0] = g_build_filename(thumb_normal_dir, thumb_basename, NULL);
+				tile->thumb_fnames[1] = g_build_filename(thumb_large_dir, thumb_basename, NULL);
+				guint j;
+				for (j = 0; j < G_N_ELEMENTS(tile->thumb_fnames); j++)
+					tile->thumb_stage_fnames[j] = g_strconcat(tile->thumb_fnames[j], ".tmp", NULL);
+			}
+		}
+	}
+
+	/* Watch for the consumer reading back published tiles */
+	if (adaptive_pacing) {
+		tile_unread = g_malloc0(iconsx * iconsy * sizeof(gboolean));
+		consumer_fd = CALL_ERRNO(inotify_init1(IN_NONBLOCK | IN_CLOEXEC), == -1);
+		CALL_ERRNO(inotify_add_watch(consumer_fd, dir, IN_CLOSE_NOWRITE), == -1);
+	}
+}
+
+const gchar *tiles_fname(guint i)
+{
+	return tiles[i].fname;
+}
+
+void tiles_start(void)
+{
+	/* Start writer and encoder threads with SIGINT left to the game thread */
+	sigset_t sigint_set, old_set;
+	sigemptyset(&sigint_set);
+	sigaddset(&sigint_set, SIGINT);
+	CALL_ERRNO(pthread_sigmask(SIG_BLOCK, &sigint_set, &old_set), != 0);
+	if (n_threads > 1)
+		encoder_pool = CALL_GERROR(g_thread_pool_new, &encode_tile, NULL, n_threads, TRUE);
+	game_thread = g_thread_self();
+	writer_thread = g_thread_new("writer", &run_writer, NULL);
+	CALL_ERRNO(pthread_sigmask(SIG_SETMASK, &old_set, NULL), != 0);
+
+	CALL_ERRNO(clock_gettime(CLOCK_MONOTONIC, &ts_start), == -1);
+}
+
+void tiles_cleanup(void)
+{
+	/* Report how precisely tic deadlines were met */
+	if (sleep_count)
+		printf("DG_SleepUntilMs: %u sleeps, lateness mean %" G_GUINT64_FORMAT " us, max %" G_GUINT64_FORMAT " us\n",
+		       sleep_count, sleep_lateness_total / sleep_count, sleep_lateness_max);
+
+	/* Stop writer and encoder threads, unless exiting from one of them */
+	if (writer_thread && g_thread_self() == game_thread) {
+		g_mutex_lock(&frame_mutex);
+		writer_quit = TRUE;
+		g_cond_signal(&frame_cond);
+		g_mutex_unlock(&frame_mutex);
+		g_thread_join(writer_thread);
+	}
+	if (encoder_pool)
+		g_thread_pool_free(encoder_pool, TRUE, FALSE);
+
+	if (print_timings && frames_published)
+		printf("Tiles: %u frames published, %u dropped, encode mean %" G_GUINT64_FORMAT " us, publish mean %" G_GUINT64_FORMAT " us\n",
+		       frames_published, frames_dropped, encode_us_total / frames_published, publish_us_total / frames_published);
+
+	/* Delete files */
+	guint i;
+	for (i = 0; tile_dir && i < iconsx * iconsy; i++) {
+		g_unlink(tiles[i].fname);
+		g_unlink(tiles[i].stage_fname);
+		close(tiles[i].front_fd);
+		close(tiles[i].back_fd);
+		g_free(tiles[i].fname);
+		g_free(tiles[i].stage_fname);
+		guint j;
+		for (j = 0; j < G_N_ELEMENTS(tiles[i].thumb_fnames); j++) {
+			if (tiles[i].thumb_fnames[j]) {
+				g_unlink(tiles[i].thumb_fnames[j]);
+				g_unlink(tiles[i].thumb_stage_fnames[j]);
+			}
+			g_free(tiles[i].thumb_fnames[j]);
+			g_free(tiles[i].thumb_stage_fnames[j]);
+		}
+		g_free(tiles[i].uri);
+	}
+	if (consumer_fd != -1)
+		close(consumer_fd);
+
+	/* Free resources */
+	for (i = 0; i < G_N_ELEMENTS(frames); i++)
+		g_free(frames[i].pixels);
+	g_free(tile_dir);
+	g_free(tile_cache);
+	g_free(tiles);
+	g_free(tile_dirty);
+	g_free(tile_unread);
+}
+
+gint create_tile_file(const gchar *fname, const gchar *header)
+{
+	gint fd = CALL_ERRNO(g_open(fname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644), == -1);
+	CALL_ERRNO(write(fd, header, header_len), != header_len);
+	CALL_ERRNO(pwrite(fd, tile_cache, img_len, header_len), != img_len);
+	return fd;
+}
+
+void publish_tile(guint i)
+{
+	struct Tile *tile = &tiles[i];
+
+	/* Without exchange support the encoder already rewrote the tile in place */
+	if (G_UNLIKELY(!frame_staged)) {
+		if (write_thumbnails)
+			publish_thumbnail(i);
+		return;
+	}
+
+	if (G_LIKELY(exchange_supported)) {
+		if (!renameat2(AT_FDCWD, tile->stage_fname, AT_FDCWD, tile->fname, RENAME_EXCHANGE)) {
+			gint fd = tile->front_fd;
+			tile->front_fd = tile->back_fd;
+			tile->back_fd = fd;
+			if (write_thumbnails)
+				publish_thumbnail(i);
+			return;
+		}
+		if (errno != EINVAL && errno != ENOSYS)
+			I_Error("Error %d: %s", errno, strerror(errno));
+
+		/* Filesystem cannot swap names atomically, so rewrite tiles in place */
+		exchange_supported = FALSE;
+	}
+
+	/* The rest of this frame was still staged, so copy it over the published inode */
+	CALL_ERRNO(pwrite(tile->front_fd, tile_cache + i * img_len, img_len, header_len), != img_len);
+	if (write_thumbnails) {
+		write_thumbnail(i, tile->front_fd, tile_cache + i * img_len);
+		publish_thumbnail(i);
+	}
+}
+
+void init_crc_table(void)
+{
+	guint32 n, k;
+	for (n = 0; n < 256; n++) {
+		guint32 c = n;
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		crc_table[n] = c;
+	}
+}
+
+guint32 update_crc(guint32 crc, const guint8 *buf, gsize len)
+{
+	gsize n;
+	for (n = 0; n < len; n++)
+		crc = crc_table[(crc ^ buf[n]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+void append_be32(GByteArray *array, guint32 val)
+{
+	const guint8 bytes[] = { val >> 24, val >> 16, val >> 8, val };
+	g_byte_array_append(array, bytes, sizeof(bytes));
+}
+
+guint png_begin_chunk(GByteArray *png, const gchar *type)
+{
+	guint start = png->len;
+	append_be32(png, 0);
+	g_byte_array_append(png, (const guint8 *)type, 4);
+	return start;
+}
+
+void png_end_chunk(GByteArray *png, guint start)
+{
+	/* Patch in the length, then checksum the type and data */
+	guint32 len = png->len - start - 8;
+	png->data[start] = len >> 24;
+	png->data[start + 1] = len >> 16;
+	png->data[start + 2] = len >> 8;
+	png->data[start + 3] = len;
+	append_be32(png, update_crc(0xFFFFFFFFu, png->data + start + 4, len + 4) ^ 0xFFFFFFFFu);
+}
+
+void deflate_stored(struct Deflate *z, const guint8 *data, guint len)
+{
+	/* Emit data as uncompressed deflate blocks, tracking its Adler-32 */
+	while (len) {
+		if (!z->block_left) {
+			z->block_left = MIN(z->total_left, 0xFFFF);
+			const guint8 header[] = {
+				z->block_left == z->total_left,
+				z->block_left,
+				z->block_left >> 8,
+				~z->block_left,
+				~z->block_left >> 8,
+			};
+			g_byte_array_append(z->out, header, sizeof(header));
+		}
+		guint n = MIN(len, z->block_left);
+		g_byte_array_append(z->out, data, n);
+		guint j;
+		for (j = 0; j < n; j++) {
+			z->adler_a = (z->adler_a + data[j]) % 65521;
+			z->adler_b = (z->adler_b + z->adler_a) % 65521;
+		}
+		z->block_left -= n;
+		z->total_left -= n;
+		data += n;
+		len -= n;
+	}
+}
+
+void encode_png(GByteArray *png, const gchar *payload, const gchar *uri, gint64 mtime)
+{
+	static const guint8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	g_byte_array_append(png, signature, sizeof(signature));
+
+	guint chunk = png_begin_chunk(png, "IHDR");
+	append_be32(png, icon_res);
+	append_be32(png, icon_res);
+	const guint8 ihdr[] = {
+		8, /* Bit depth */
+		DG_IndexedOutput ? 3 : 2, /* Colour type */
+		0, /* Compression */
+		0, /* Filter */
+		0, /* Interlace */
+	};
+	g_byte_array_append(png, ihdr, sizeof(ihdr));
+	png_end_chunk(png, chunk);
+
+	guint row_len = icon_res * 3;
+	if (DG_IndexedOutput) {
+		chunk = png_begin_chunk(png, "PLTE");
+		guint i;
+		for (i = 0; i < 256; i++) {
+			const guint8 rgb[] = { payload[i * 4 + 2], payload[i * 4 + 1], payload[i * 4] };
+			g_byte_array_append(png, rgb, sizeof(rgb));
+		}
+		png_end_chunk(png, chunk);
+		row_len = icon_res;
+	}
+
+	g_autofree gchar *mtime_str = g_strdup_printf("%" G_GINT64_FORMAT, mtime);
+	const gchar *text[][2] = {
+		{ "Thumb::URI", uri },
+		{ "Thumb::MTime", mtime_str },
+	};
+	guint i;
+	for (i = 0; i < G_N_ELEMENTS(text); i++) {
+		chunk = png_begin_chunk(png, "tEXt");
+		g_byte_array_append(png, (const guint8 *)text[i][0], strlen(text[i][0]) + 1);
+		g_byte_array_append(png, (const guint8 *)text[i][1], strlen(text[i][1]));
+		png_end_chunk(png, chunk);
+	}
+
+	/* Scanlines without filtering, in a zlib stream of stored blocks */
+	chunk = png_begin_chunk(png, "IDAT");
+	const guint8 zlib_header[] = { 0x78, 0x01 };
+	g_byte_array_append(png, zlib_header, sizeof(zlib_header));
+	struct Deflate z = {
+		.out = png,
+		.total_left = icon_res * (1 + row_len),
+		.adler_a = 1,
+	};
+	guint imgy;
+	for (imgy = 0; imgy < icon_res; imgy++) {
+		const guint8 filter = 0;
+		deflate_stored(&z, &filter, 1);
+		const gchar *row = DG_IndexedOutput ? payload + 256 * 4 + (icon_res - 1 - imgy) * bmp_stride : payload + imgy * row_len;
+		deflate_stored(&z, (const guint8 *)row, row_len);
+	}
+	append_be32(png, (z.adler_b << 16) | z.adler_a);
+	png_end_chunk(png, chunk);
+
+	chunk = png_begin_chunk(png, "IEND");
+	png_end_chunk(png, chunk);
+}
+
+void write_thumbnail(guint i, gint fd, const gchar *payload)
+{
+	struct Tile *tile = &tiles[i];
+
+	/* Thumb::MTime must match the tile that is about to be published */
+	struct stat st;
+	CALL_ERRNO(fstat(fd, &st), == -1);
+
+	GByteArray *png = g_private_get(&png_buffer);
+	if (G_UNLIKELY(!png)) {
+		png = g_byte_array_new();
+		g_private_set(&png_buffer, png);
+	}
+	g_byte_array_set_size(png, 0);
+	encode_png(png, payload, tile->uri, st.st_mtime);
+
+	/* Staged only, publish_thumbnail moves them into place along with the tile */
+	guint j;
+	for (j = 0; j < G_N_ELEMENTS(tile->thumb_fnames); j++) {
+		gint thumb_fd = CALL_ERRNO(g_open(tile->thumb_stage_fnames[j], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600), == -1);
+		CALL_ERRNO(write(thumb_fd, png->data, png->len), != png->len);
+		CALL_ERRNO(close(thumb_fd), == -1);
+	}
+}
+
+void publish_thumbnail(guint i)
+{
+	struct Tile *tile = &tiles[i];
+	guint j;
+	for (j = 0; j < G_N_ELEMENTS(tile->thumb_fnames); j++)
+		CALL_ERRNO(g_rename(tile->thumb_stage_fnames[j], tile->thumb_fnames[j]), == -1);
+}
+
+void encode_ppm(gchar *buffer, guint x, guint y)
+{
+	struct Color *pixels = frame_front->pixels;
+
+	memset(buffer, '\0', img_len);
+	guint imgx, imgy;
+	for (imgy = 0; imgy < MIN(icon_res, DOOMGENERIC_RESY - y * icon_res); imgy++) {
+		for (imgx = 0; imgx < MIN(icon_res, DOOMGENERIC_RESX - x * icon_res); imgx++) {
+			struct Color pix = pixels[(y * icon_res + imgy) * DOOMGENERIC_RESX + (x * icon_res + imgx)];
+			guint imgi = (imgy * icon_res + imgx) * 3;
+			buffer[imgi] = pix.r;
+			buffer[imgi + 1] = pix.g;
+			buffer[imgi + 2] = pix.b;
+		}
+	}
+}
+
+void encode_bmp(gchar *buffer, guint x, guint y)
+{
+	/* Palette entries are stored as BGR0 */
+	guint i;
+	for (i = 0; i < 256; i++) {
+		buffer[i * 4] = frame_front->palette[i];
+		buffer[i * 4 + 1] = frame_front->palette[i] >> 8;
+		buffer[i * 4 + 2] = frame_front->palette[i] >> 16;
+		buffer[i * 4 + 3] = 0;
+	}
+
+	/* Rows are stored bottom-up, padded to 4 bytes */
+	gchar *rows = buffer + 256 * 4;
+	memset(rows, '\0', bmp_stride * icon_res);
+	guint width = MIN(icon_res, DOOMGENERIC_RESX - x * icon_res);
+	guint imgy;
+	for (imgy = 0; imgy < MIN(icon_res, DOOMGENERIC_RESY - y * icon_res); imgy++)
+		memcpy(rows + (icon_res - 1 - imgy) * bmp_stride,
+		       (guint8 *)frame_front->pixels + (y * icon_res + imgy) * DOOMGENERIC_RESX + x * icon_res, width);
+}
+
+void encode_tile(gpointer data, gpointer user_data)
+{
+	guint i = GPOINTER_TO_UINT(data) - 1;
+	guint x = i % iconsx;
+	guint y = i / iconsx;
+
+	/* Each worker converts into its own buffer */
+	gchar *buffer = g_private_get(&encoder_buffer);
+	if (G_UNLIKELY(!buffer)) {
+		buffer = g_malloc(img_len);
+		g_private_set(&encoder_buffer, buffer);
+	}
+
+	if (DG_IndexedOutput)
+		encode_bmp(buffer, x, y);
+	else
+		encode_ppm(buffer, x, y);
+
+	/* Skip tiles identical to what was last published */
+	gchar *cached = tile_cache + i * img_len;
+	tile_dirty[i] = memcmp(cached, buffer, img_len) != 0;
+	if (tile_dirty[i])
+		memcpy(cached, buffer, img_len);
+
+	/* In-memory tiles are done once cached */
+	if (tile_dirty[i] && tile_dir) {
+		gint fd = G_LIKELY(frame_staged) ? tiles[i].back_fd : tiles[i].front_fd;
+		CALL_ERRNO(pwrite(fd, buffer, img_len, header_len), != img_len);
+		if (write_thumbnails)
+			write_thumbnail(i, fd, buffer);
+	}
+
+	g_mutex_lock(&encoder_mutex);
+	if (!--encoder_pending)
+		g_cond_signal(&encoder_cond);
+	g_mutex_unlock(&encoder_mutex);
+	(void)user_data;
+}
+
+gboolean tile_damaged(guint i)
+{
+	gint x = i % iconsx * icon_res;
+	gint y = i / iconsx * icon_res;
+	return frame_front->damage_x1 < frame_front->damage_x2 && frame_front->damage_x1 < x + (gint)icon_res &&
+	       x < frame_front->damage_x2 && frame_front->damage_y1 < y + (gint)icon_res && y < frame_front->damage_y2;
+}
+
+void add_damage(struct Frame *frame, gint x1, gint y1, gint x2, gint y2)
+{
+	if (x1 >= x2 || y1 >= y2)
+		return;
+	if (frame->damage_x1 >= frame->damage_x2) {
+		frame->damage_x1 = x1;
+		frame->damage_y1 = y1;
+		frame->damage_x2 = x2;
+		frame->damage_y2 = y2;
+		return;
+	}
+	frame->damage_x1 = MIN(frame->damage_x1, x1);
+	frame->damage_y1 = MIN(frame->damage_y1, y1);
+	frame->damage_x2 = MAX(frame->damage_x2, x2);
+	frame->damage_y2 = MAX(frame->damage_y2, y2);
+}
+
+gint tile_from_name(const gchar *name)
+{
+	/* Staged and published names both map to the tile */
+	if (*name == '.')
+		name++;
+	if (strlen(name) != 6 || strcmp(name + 2, tile_ext))
+		return -1;
+	guint x = name[0] - 'a';
+	guint y = name[1] - 'a';
+	if (x >= iconsx || y >= iconsy)
+		return -1;
+	return y * iconsx + x;
+}
+
+gboolean read_consumer_events(void)
+{
+	gchar buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len = read(consumer_fd, buf, sizeof(buf));
+	if (len == -1) {
+		if (errno != EAGAIN)
+			I_Error("Error %d: %s", errno, strerror(errno));
+		return FALSE;
+	}
+
+	gchar *ptr;
+	for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event *)ptr)->len) {
+		const struct inotify_event *event = (struct inotify_event *)ptr;
+		if (!event->len)
+			continue;
+		gint i = tile_from_name(event->name);
+		if (i >= 0 && tile_unread[i]) {
+			tile_unread[i] = FALSE;
+			n_unread--;
+		}
+	}
+	return TRUE;
+}
+
+void wait_for_consumer(void)
+{
+	/* frame_delay bounds the wait in case some tiles are never read */
+	gint64 deadline = g_get_monotonic_time() + frame_delay * 1000LL;
+	while (n_unread) {
+		gint64 remaining = deadline - g_get_monotonic_time();
+		if (remaining <= 0)
+			break;
+		struct pollfd pfd = {
+			.fd = consumer_fd,
+			.events = POLLIN,
+		};
+		if (CALL_ERRNO(poll(&pfd, 1, (remaining + 999) / 1000), == -1 && errno != EINTR) > 0)
+			while (read_consumer_events())
+				;
+	}
+}
+
+gchar *create_header(void)
+{
+	if (!DG_IndexedOutput) {
+		gchar *header = g_strdup_printf("P6\n%u %u\n255\n", icon_res, icon_res);
+		header_len = strlen(header);
+		return header;
+	}
+
+	/* BITMAPFILEHEADER and BITMAPINFOHEADER of an 8-bit bottom-up image, followed by the palette */
+	header_len = 14 + 40;
+	guint32 fields[] = {
+		header_len + img_len, /* File size */
+		0, /* Reserved */
+		header_len + 256 * 4, /* Pixel data offset */
+		40, /* Info header size */
+		icon_res, /* Width */
+		icon_res, /* Height */
+		1 | (8 << 16), /* Planes, bits per pixel */
+		0, /* Compression */
+		bmp_stride * icon_res, /* Image size */
+		2835, /* Horizontal pixels per metre */
+		2835, /* Vertical pixels per metre */
+		256, /* Palette size */
+		0, /* Important colours */
+	};
+	guchar *header = g_malloc(header_len);
+	header[0] = 'B';
+	header[1] = 'M';
+	guint i;
+	for (i = 0; i < G_N_ELEMENTS(fields); i++) {
+		header[2 + i * 4] = fields[i];
+		header[2 + i * 4 + 1] = fields[i] >> 8;
+		header[2 + i * 4 + 2] = fields[i] >> 16;
+		header[2 + i * 4 + 3] = fields[i] >> 24;
+	}
+	return (gchar *)header;
+}
+
+void publish_frame(void)
+{
+	guint n_tiles = iconsx * iconsy;
+	gint64 time_start = g_get_monotonic_time();
+
+	/* Stage the payload of every changed tile, leaving out those the damage misses */
+	guint i;
+	frame_staged = exchange_supported;
+	encoder_pending = 0;
+	for (i = 0; i < n_tiles; i++)
+		encoder_pending += tile_damaged(i);
+	for (i = 0; i < n_tiles; i++) {
+		if (!tile_damaged(i))
+			tile_dirty[i] = FALSE;
+		else if (encoder_pool)
+			CALL_GERROR(g_thread_pool_push, encoder_pool, GUINT_TO_POINTER(i + 1));
+		else
+			encode_tile(GUINT_TO_POINTER(i + 1), NULL);
+	}
+
+	g_mutex_lock(&encoder_mutex);
+	while (encoder_pending)
+		g_cond_wait(&encoder_cond, &encoder_mutex);
+	g_mutex_unlock(&encoder_mutex);
+	gint64 time_encoded = g_get_monotonic_time();
+
+	/* Forget reads of earlier frames */
+	if (adaptive_pacing)
+		while (read_consumer_events())
+			;
+
+	/* Publish the whole frame at once */
+	n_unread = 0;
+	guint n_dirty = 0;
+	for (i = 0; i < n_tiles; i++) {
+		if (tile_dirty[i] && tile_dir)
+			publish_tile(i);
+		if (adaptive_pacing) {
+			tile_unread[i] = tile_dirty[i];
+			n_unread += tile_dirty[i];
+		}
+		n_dirty += tile_dirty[i];
+	}
+	gint64 time_published = g_get_monotonic_time();
+
+	if (adaptive_pacing)
+		wait_for_consumer();
+	else
+		g_usleep(frame_delay * 1000UL);
+
+	frames_published++;
+	encode_us_total += time_encoded - time_start;
+	publish_us_total += time_published - time_encoded;
+	if (print_timings)
+		printf("Frame %u: %u/%u tiles changed, encode %" G_GINT64_FORMAT " us, publish %" G_GINT64_FORMAT " us, wait %" G_GINT64_FORMAT " us\n",
+		       frames_published, n_dirty, n_tiles, time_encoded - time_start, time_published - time_encoded,
+		       g_get_monotonic_time() - time_published);
+}
+
+gpointer run_writer(gpointer data)
+{
+	for (;;) {
+		/* Take the newest frame, dropping any the game produced in the meantime */
+		g_mutex_lock(&frame_mutex);
+		while (!frame_fresh && !writer_quit)
+			g_cond_wait(&frame_cond, &frame_mutex);
+		if (writer_quit) {
+			g_mutex_unlock(&frame_mutex);
+			return NULL;
+		}
+		struct Frame *frame = frame_front;
+		frame_front = frame_pending;
+		frame_pending = frame;
+		frame_fresh = FALSE;
+		g_mutex_unlock(&frame_mutex);
+
+		publish_frame();
+	}
+	(void)data;
+}
+
+void DG_DrawFrame()
+{
+	/* Copy the frame into the free slot, then make it the pending one */
+	if (DG_IndexedOutput) {
+		memcpy(frame_back->pixels, DG_IndexedBuffer, DOOMGENERIC_RESX * DOOMGENERIC_RESY);
+		memcpy(frame_back->palette, DG_Palette, sizeof(DG_Palette));
+	} else {
+		memcpy(frame_back->pixels, DG_ScreenBuffer, DOOMGENERIC_RESX * DOOMGENERIC_RESY * 4);
+	}
+
+	g_mutex_lock(&frame_mutex);
+	struct Frame *frame = frame_pending;
+	/* A dropped frame's changes still have to reach the tiles */
+	if (frame_fresh)
+		add_damage(frame_back, frame->damage_x1, frame->damage_y1, frame->damage_x2, frame->damage_y2);
+	frame_pending = frame_back;
+	frame_back = frame;
+	frames_dropped += frame_fresh;
+	frame_fresh = TRUE;
+	g_cond_signal(&frame_cond);
+	g_mutex_unlock(&frame_mutex);
+}
+
+void DG_DamageRect(int x, int y, int width, int height)
+{
+	/* The slot still holds the damage of the frame it last carried */
+	frame_back->damage_x1 = frame_back->damage_x2 = 0;
+	add_damage(frame_back, x, y, x + width, y + height);
+}
+
+void DG_SleepMs(uint32_t ms)
+{
+	g_usleep(ms * 1000UL);
+}
+
+void DG_SleepUntilMs(uint32_t ms)
+{
+	struct timespec deadline = {
+		.tv_sec = ts_start.tv_sec + ms / 1000,
+		.tv_nsec = ts_start.tv_nsec + (ms % 1000) * 1000000L,
+	};
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	gint err;
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)) == EINTR)
+		;
+	if (G_UNLIKELY(err))
+		I_Error("Error %d: %s", err, strerror(err));
+
+	/* Track how late the wakeup was */
+	struct timespec ts_now;
+	clock_gettime(CLOCK_MONOTONIC, &ts_now);
+	gint64 lateness = ((ts_now.tv_sec - deadline.tv_sec) * (gint64)1000000000 + (ts_now.tv_nsec - deadline.tv_nsec)) / 1000;
+	if (lateness > 0) {
+		sleep_lateness_total += lateness;
+		sleep_lateness_max = MAX(sleep_lateness_max, (guint64)lateness);
+	}
+	sleep_count++;
+}
+
+uint32_t DG_GetTicksMs()
+{
+	struct timespec ts_now;
+	clock_gettime(CLOCK_MONOTONIC, &ts_now);
+	/* Divide the whole difference so the result rounds down, never past a deadline not yet reached */
+	gint64 elapsed_ns = (ts_now.tv_sec - ts_start.tv_sec) * (gint64)1000000000 + (ts_now.tv_nsec - ts_start.tv_nsec);
+	return elapsed_ns / 1000000;
+}
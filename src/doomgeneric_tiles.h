@@ -0,0 +1,80 @@
+//
+// Copyright(C) 2023 Wojciech Graj
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Tile publishing shared by the desktop and headless backends
+//
+
+#ifndef DOOMGENERIC_TILES_H
+#define DOOMGENERIC_TILES_H
+
+#include "i_system.h"
+
+#include <glib.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CALL_ERRNO(invoc, cond)                                          \
+	({                                                               \
+		typeof(invoc) res = (invoc);                             \
+		if (G_UNLIKELY(res cond)) {                              \
+			I_Error("Error %d: %s", errno, strerror(errno)); \
+			exit(errno);                                     \
+		}                                                        \
+		res;                                                     \
+	})
+
+#define CALL_MSG(invoc, cond, msg)                 \
+	({                                         \
+		typeof(invoc) res = (invoc);       \
+		if (G_UNLIKELY(res cond)) {        \
+			I_Error("Error: %s", msg); \
+			exit(1);                   \
+		}                                  \
+		res;                               \
+	})
+
+#define CALL_GERROR(func, ...)                                                         \
+	({                                                                             \
+		GError *error = NULL;                                                  \
+		typeof((func)(__VA_ARGS__, &error)) res = (func)(__VA_ARGS__, &error); \
+		if (G_UNLIKELY(error)) {                                               \
+			I_Error("Error: %s\n", error->message);                        \
+			g_error_free(error);                                           \
+			exit(1);                                                       \
+		}                                                                      \
+		res;                                                                   \
+	})
+
+/* Number of tile columns and rows, valid after tiles_init */
+extern guint iconsx;
+extern guint iconsy;
+
+/* Parses the tile arguments and allocates the tile state */
+void tiles_init(void);
+
+/* Creates the tile files in dir, or keeps tiles in memory only if dir is NULL */
+void tiles_create_files(const gchar *dir);
+
+/* Published name of tile i, or NULL for in-memory tiles */
+const gchar *tiles_fname(guint i);
+
+/* Starts the timebase and the writer and encoder threads */
+void tiles_start(void);
+
+/* Stops the threads, deletes the tile files and reports statistics */
+void tiles_cleanup(void);
+
+#endif
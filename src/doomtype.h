@@ -52,6 +52,18 @@
 #define PACKEDATTR
 #endif
 
+//
+// Renderer state that each render thread keeps its own copy of is
+// declared thread-local, so the parallel renderer can run R_RenderPlayerView
+// on several threads at once.
+//
+
+#ifdef _MSC_VER
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
+
 // C99 integer types; with gcc we just use this.  Other compilers 
 // should add conditional statements that define the C99 types.
 
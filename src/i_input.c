@@ -281,9 +281,10 @@ void I_GetEvent(void)
     event_t event;
     int pressed;
     unsigned char key;
+    uint32_t timestamp;
 
     
-	while (DG_GetKey(&pressed, &key))
+	while (DG_GetKey(&pressed, &key, &timestamp))
     {
         UpdateShiftStatus(pressed, key);
 
@@ -296,6 +297,7 @@ void I_GetEvent(void)
             event.type = ev_keydown;
             event.data1 = TranslateKey(key);
             event.data2 = GetTypedChar(key);
+            event.timestamp = timestamp;
 
             if (event.data1 != 0)
             {
@@ -314,6 +316,7 @@ void I_GetEvent(void)
             // (key ID), not the printable char.
 
             event.data2 = 0;
+            event.timestamp = timestamp;
 
             if (event.data1 != 0)
             {
@@ -80,6 +80,22 @@ void I_Sleep(int ms)
 	DG_SleepMs(ms);
 }
 
+// Sleep until the given tic starts
+
+void I_SleepUntilTic(int tic)
+{
+    uint32_t ms;
+
+    if (basetime == 0)
+        basetime = I_GetTicks();
+
+    // First millisecond at which I_GetTime returns tic
+
+    ms = ((uint32_t) tic * 1000 + TICRATE - 1) / TICRATE;
+
+    DG_SleepUntilMs(basetime + ms);
+}
+
 void I_WaitVBL(int count)
 {
     //I_Sleep((count * 1000) / 70);
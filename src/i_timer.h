@@ -32,6 +32,9 @@ int I_GetTimeMS (void);
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
+// Pause until the given tic (as returned by I_GetTime) starts
+void I_SleepUntilTic(int tic);
+
 // Initialize timer
 void I_InitTimer(void);
 
@@ -32,6 +32,7 @@ rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 #include "d_main.h"
 #include "i_video.h"
 #include "z_zone.h"
+#include "m_bbox.h"
 
 #include "tables.h"
 #include "doomkeys.h"
@@ -47,6 +48,11 @@ rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 
 #include <sys/types.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define I_VIDEO_X86
+#include <immintrin.h>
+#endif
+
 //#define CMAP256
 
 struct FB_BitField
@@ -84,6 +90,18 @@ struct color {
 
 static struct color colors[256];
 
+// The palette as framebuffer pixels, built by I_SetPalette
+
+static uint32_t fb_palette[256];
+
+// Converts a row of the screen, picked by I_InitGraphics
+
+static void (*cmap_to_fb_row)(uint8_t *out, uint8_t *in, int in_pixels);
+
+// Set by I_SetPalette, as every pixel then changes color
+
+static boolean palette_changed;
+
 void I_GetEvent(void);
 
 // The screen buffer; this is modified to draw things to the screen
@@ -150,19 +168,11 @@ void cmap_to_rgb565(uint16_t * out, uint8_t * in, int in_pixels)
 void cmap_to_fb(uint8_t * out, uint8_t * in, int in_pixels)
 {
     int i, j, k;
-    struct color c;
     uint32_t pix;
-    uint16_t r, g, b;
 
     for (i = 0; i < in_pixels; i++)
     {
-        c = colors[*in];  /* R:8 G:8 B:8 format! */
-        r = (uint16_t)(c.r >> (8 - s_Fb.red.length));
-        g = (uint16_t)(c.g >> (8 - s_Fb.green.length));
-        b = (uint16_t)(c.b >> (8 - s_Fb.blue.length));
-        pix = r << s_Fb.red.offset;
-        pix |= g << s_Fb.green.offset;
-        pix |= b << s_Fb.blue.offset;
+        pix = fb_palette[*in];
 
         for (k = 0; k < fb_scaling; k++) {
             for (j = 0; j < s_Fb.bits_per_pixel/8; j++) {
@@ -174,6 +184,64 @@ void cmap_to_fb(uint8_t * out, uint8_t * in, int in_pixels)
     }
 }
 
+// The same for 32-bit pixels, a whole pixel at a time
+
+static void cmap_to_fb32(uint8_t * out, uint8_t * in, int in_pixels)
+{
+    int i, k;
+    uint32_t pix;
+
+    for (i = 0; i < in_pixels; i++)
+    {
+        pix = fb_palette[*in++];
+
+        for (k = 0; k < fb_scaling; k++) {
+            memcpy(out, &pix, sizeof(pix));
+            out += sizeof(pix);
+        }
+    }
+}
+
+#ifdef I_VIDEO_X86
+
+// Looks up eight pixels at once, doubling them for a scaling of 2,
+// and leaves other scalings and the last few pixels to cmap_to_fb32
+
+__attribute__((target("avx2")))
+static void cmap_to_fb32_avx2(uint8_t * out, uint8_t * in, int in_pixels)
+{
+    __m256i index, pix;
+    __m256i double_lo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    __m256i double_hi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    int i = 0;
+
+    if (fb_scaling == 1)
+    {
+        for (; i + 8 <= in_pixels; i += 8)
+        {
+            index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *) (in + i)));
+            pix = _mm256_i32gather_epi32((const int *) fb_palette, index, 4);
+            _mm256_storeu_si256((__m256i *) (out + i * 4), pix);
+        }
+    }
+    else if (fb_scaling == 2)
+    {
+        for (; i + 8 <= in_pixels; i += 8)
+        {
+            index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *) (in + i)));
+            pix = _mm256_i32gather_epi32((const int *) fb_palette, index, 4);
+            _mm256_storeu_si256((__m256i *) (out + i * 8),
+                                _mm256_permutevar8x32_epi32(pix, double_lo));
+            _mm256_storeu_si256((__m256i *) (out + i * 8 + 32),
+                                _mm256_permutevar8x32_epi32(pix, double_hi));
+        }
+    }
+
+    cmap_to_fb32(out + i * 4 * fb_scaling, in + i, in_pixels - i);
+}
+
+#endif
+
 void I_InitGraphics (void)
 {
     int i;
@@ -217,9 +285,26 @@ void I_InitGraphics (void)
         printf("I_InitGraphics: Auto-scaling factor: %d\n", fb_scaling);
     }
 
+    cmap_to_fb_row = cmap_to_fb;
+
+    if (s_Fb.bits_per_pixel == 32)
+    {
+        cmap_to_fb_row = cmap_to_fb32;
+
+#ifdef I_VIDEO_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2") && M_CheckParm("-nosimd") == 0)
+        {
+            cmap_to_fb_row = cmap_to_fb32_avx2;
+        }
+#endif
+    }
+
 
     /* Allocate screen to draw to */
 	I_VideoBuffer = (byte*)Z_Malloc (SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);  // For DOOM to draw on
+	DG_IndexedBuffer = I_VideoBuffer;
 
 	screenvisible = true;
 
@@ -246,6 +331,24 @@ void I_UpdateNoBlit (void)
 {
 }
 
+//
+// I_DamageFrame
+// Tells the backend which part of the frame changed.
+//
+
+static void I_DamageFrame (void)
+{
+    if (numdirtyrects == 0)
+    {
+        DG_DamageRect(0, 0, 0, 0);
+        return;
+    }
+
+    DG_DamageRect(dirtybox[BOXLEFT], dirtybox[BOXBOTTOM],
+                  dirtybox[BOXRIGHT] - dirtybox[BOXLEFT] + 1,
+                  dirtybox[BOXTOP] - dirtybox[BOXBOTTOM] + 1);
+}
+
 //
 // I_FinishUpdate
 //
@@ -253,9 +356,26 @@ void I_UpdateNoBlit (void)
 void I_FinishUpdate (void)
 {
     int y;
-    int x_offset, y_offset, x_offset_end;
+    int x_offset, y_offset, line_len;
+    int r;
+    vrect_t *rect;
     unsigned char *line_in, *line_out;
 
+    if (palette_changed)
+    {
+        V_MarkRect(0, 0, SCREENWIDTH, SCREENHEIGHT);
+        palette_changed = false;
+    }
+
+    /* Backend encodes straight from I_VideoBuffer */
+    if (DG_IndexedOutput)
+    {
+        I_DamageFrame();
+        DG_DrawFrame();
+        V_ClearDirty();
+        return;
+    }
+
     /* Offsets in case FB is bigger than DOOM */
     /* 600 = s_Fb heigt, 200 screenheight */
     /* 600 = s_Fb heigt, 200 screenheight */
@@ -263,35 +383,42 @@ void I_FinishUpdate (void)
     y_offset     = (((s_Fb.yres - (SCREENHEIGHT * fb_scaling)) * s_Fb.bits_per_pixel/8)) / 2;
     x_offset     = (((s_Fb.xres - (SCREENWIDTH  * fb_scaling)) * s_Fb.bits_per_pixel/8)) / 2; // XXX: siglent FB hack: /4 instead of /2, since it seems to handle the resolution in a funny way
     //x_offset     = 0;
-    x_offset_end = ((s_Fb.xres - (SCREENWIDTH  * fb_scaling)) * s_Fb.bits_per_pixel/8) - x_offset;
+    line_len     = s_Fb.xres * s_Fb.bits_per_pixel/8;
 
-    /* DRAW SCREEN */
-    line_in  = (unsigned char *) I_VideoBuffer;
-    line_out = (unsigned char *) DG_ScreenBuffer;
+    /* DRAW SCREEN, only where it changed */
+    for (r = 0; r < numdirtyrects; r++)
+    {
+        rect = &dirtyrects[r];
 
-    y = SCREENHEIGHT;
+        for (y = rect->y; y < rect->y + rect->height; y++)
+        {
+            int i;
+            line_in  = (unsigned char *) I_VideoBuffer + y * SCREENWIDTH + rect->x;
+            line_out = (unsigned char *) DG_ScreenBuffer + y * fb_scaling * line_len
+                     + x_offset + rect->x * fb_scaling * (s_Fb.bits_per_pixel/8);
 
-    while (y--)
-    {
-        int i;
-        for (i = 0; i < fb_scaling; i++) {
-            line_out += x_offset;
 #ifdef CMAP256
-            for (fb_scaling == 1) {
-                memcpy(line_out, line_in, SCREENWIDTH); /* fb_width is bigger than Doom SCREENWIDTH... */
+            if (fb_scaling == 1) {
+                memcpy(line_out, line_in, rect->width); /* fb_width is bigger than Doom SCREENWIDTH... */
             } else {
                 //XXX FIXME fb_scaling support!
             }
 #else
-            //cmap_to_rgb565((void*)line_out, (void*)line_in, SCREENWIDTH);
-            cmap_to_fb((void*)line_out, (void*)line_in, SCREENWIDTH);
+            //cmap_to_rgb565((void*)line_out, (void*)line_in, rect->width);
+            cmap_to_fb_row((void*)line_out, (void*)line_in, rect->width);
 #endif
-            line_out += (SCREENWIDTH * fb_scaling * (s_Fb.bits_per_pixel/8)) + x_offset_end;
+
+            /* The other scaled lines repeat the first */
+            for (i = 1; i < fb_scaling; i++) {
+                memcpy(line_out + i * line_len, line_out,
+                       rect->width * fb_scaling * (s_Fb.bits_per_pixel/8));
+            }
         }
-        line_in += SCREENWIDTH;
     }
 
+    I_DamageFrame();
 	DG_DrawFrame();
+    V_ClearDirty();
 }
 
 //
@@ -335,7 +462,13 @@ void I_SetPalette (byte* palette)
         colors[i].r = gammatable[usegamma][*palette++];
         colors[i].g = gammatable[usegamma][*palette++];
         colors[i].b = gammatable[usegamma][*palette++];
+        DG_Palette[i] = (colors[i].r << 16) | (colors[i].g << 8) | colors[i].b;
+        fb_palette[i] = ((uint32_t) (colors[i].r >> (8 - s_Fb.red.length)) << s_Fb.red.offset)
+                      | ((uint32_t) (colors[i].g >> (8 - s_Fb.green.length)) << s_Fb.green.offset)
+                      | ((uint32_t) (colors[i].b >> (8 - s_Fb.blue.length)) << s_Fb.blue.offset);
     }
+
+    palette_changed = true;
 }
 
 // Given an RGB value, find the closest matching palette index.
@@ -37,6 +37,8 @@
 
 ceiling_t*	activeceilings[MAXCEILINGS];
 
+zpool_t		ceilingpool = Z_POOL(ceiling_t, PU_LEVSPEC);
+
 
 //
 // T_MoveCeiling
@@ -189,7 +191,7 @@ EV_DoCeiling
 	
 	// new door thinker
 	rtn = 1;
-	ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVSPEC, 0);
+	ceiling = Z_PoolMalloc (&ceilingpool);
 	P_AddThinker (&ceiling->thinker);
 	sec->specialdata = ceiling;
 	ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
@@ -51,6 +51,8 @@ slidename_t	slideFrameNames[MAXSLIDEDOORS] =
 // VERTICAL DOORS
 //
 
+zpool_t		doorpool = Z_POOL(vldoor_t, PU_LEVSPEC);
+
 //
 // T_VerticalDoor
 //
@@ -269,7 +271,7 @@ EV_DoDoor
 	
 	// new door thinker
 	rtn = 1;
-	door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+	door = Z_PoolMalloc (&doorpool);
 	P_AddThinker (&door->thinker);
 	sec->specialdata = door;
 
@@ -470,7 +472,7 @@ EV_VerticalDoor
 	
     
     // new door thinker
-    door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+    door = Z_PoolMalloc (&doorpool);
     P_AddThinker (&door->thinker);
     sec->specialdata = door;
     door->thinker.function.acp1 = (actionf_p1) T_VerticalDoor;
@@ -520,7 +522,7 @@ void P_SpawnDoorCloseIn30 (sector_t* sec)
 {
     vldoor_t*	door;
 	
-    door = Z_Malloc ( sizeof(*door), PU_LEVSPEC, 0);
+    door = Z_PoolMalloc (&doorpool);
 
     P_AddThinker (&door->thinker);
 
@@ -545,7 +547,7 @@ P_SpawnDoorRaiseIn5Mins
 {
     vldoor_t*	door;
 	
-    door = Z_Malloc ( sizeof(*door), PU_LEVSPEC, 0);
+    door = Z_PoolMalloc (&doorpool);
     
     P_AddThinker (&door->thinker);
 
@@ -756,7 +758,7 @@ EV_SlidingDoor
     // Init sliding door vars
     if (!door)
     {
-	door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+	door = Z_PoolMalloc (&doorpool);
 	P_AddThinker (&door->thinker);
 	sec->specialdata = door;
 		
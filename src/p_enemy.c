@@ -550,22 +550,16 @@ P_LookForPlayers
 //
 void A_KeenDie (mobj_t* mo)
 {
-    thinker_t*	th;
     mobj_t*	mo2;
     line_t	junk;
 
     A_Fall (mo);
     
-    // scan the remaining thinkers
-    // to see if all Keens are dead
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    // scan the remaining Keens
+    // to see if all are dead
+    for (mo2 = mobjsoftype[mo->type] ; mo2 ; mo2 = mo2->tnext)
     {
-	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-	    continue;
-
-	mo2 = (mobj_t *)th;
 	if (mo2 != mo
-	    && mo2->type == mo->type
 	    && mo2->health > 0)
 	{
 	    // other Keen not dead
@@ -998,6 +992,7 @@ void A_SkelMissile (mobj_t* actor)
 
     mo->x += mo->momx;
     mo->y += mo->momy;
+    P_RefreshBlockThing (mo);
     mo->tracer = actor->target;
 }
 
@@ -1455,19 +1450,13 @@ A_PainShootSkull
     angle_t	an;
     int		prestep;
     int		count;
-    thinker_t*	currentthinker;
+    mobj_t*	skull;
 
     // count total number of skull currently on the level
     count = 0;
 
-    currentthinker = thinkercap.next;
-    while (currentthinker != &thinkercap)
-    {
-	if (   (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
-	    && ((mobj_t *)currentthinker)->type == MT_SKULL)
-	    count++;
-	currentthinker = currentthinker->next;
-    }
+    for (skull = mobjsoftype[MT_SKULL] ; skull ; skull = skull->tnext)
+	count++;
 
     // if there are allready 20 skulls on the level,
     // don't spit another one
@@ -1655,7 +1644,6 @@ static boolean CheckBossEnd(mobjtype_t motype)
 //
 void A_BossDeath (mobj_t* mo)
 {
-    thinker_t*	th;
     mobj_t*	mo2;
     line_t	junk;
     int		i;
@@ -1685,16 +1673,11 @@ void A_BossDeath (mobj_t* mo)
     if (i==MAXPLAYERS)
 	return;	// no one left alive, so do not end game
     
-    // scan the remaining thinkers to see
-    // if all bosses are dead
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    // scan the remaining bosses
+    // to see if all are dead
+    for (mo2 = mobjsoftype[mo->type] ; mo2 ; mo2 = mo2->tnext)
     {
-	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-	    continue;
-	
-	mo2 = (mobj_t *)th;
 	if (mo2 != mo
-	    && mo2->type == mo->type
 	    && mo2->health > 0)
 	{
 	    // other boss not dead
@@ -1810,28 +1793,16 @@ int		braintargeton = 0;
 
 void A_BrainAwake (mobj_t* mo)
 {
-    thinker_t*	thinker;
     mobj_t*	m;
 	
     // find all the target spots
     numbraintargets = 0;
     braintargeton = 0;
 	
-    thinker = thinkercap.next;
-    for (thinker = thinkercap.next ;
-	 thinker != &thinkercap ;
-	 thinker = thinker->next)
+    for (m = mobjsoftype[MT_BOSSTARGET] ; m ; m = m->tnext)
     {
-	if (thinker->function.acp1 != (actionf_p1)P_MobjThinker)
-	    continue;	// not a mobj
-
-	m = (mobj_t *)thinker;
-
-	if (m->type == MT_BOSSTARGET )
-	{
-	    braintargets[numbraintargets] = m;
-	    numbraintargets++;
-	}
+	braintargets[numbraintargets] = m;
+	numbraintargets++;
     }
 	
     S_StartSound (NULL,sfx_bossit);
@@ -35,6 +35,8 @@
 // FLOORS
 //
 
+zpool_t		floorpool = Z_POOL(floormove_t, PU_LEVSPEC);
+
 //
 // Move a plane (floor or ceiling) and check for crushing
 //
@@ -270,7 +272,7 @@ EV_DoFloor
 	
 	// new floor thinker
 	rtn = 1;
-	floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	floor = Z_PoolMalloc (&floorpool);
 	P_AddThinker (&floor->thinker);
 	sec->specialdata = floor;
 	floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -473,7 +475,7 @@ EV_BuildStairs
 	
 	// new floor thinker
 	rtn = 1;
-	floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	floor = Z_PoolMalloc (&floorpool);
 	P_AddThinker (&floor->thinker);
 	sec->specialdata = floor;
 	floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -526,7 +528,7 @@ EV_BuildStairs
 					
 		sec = tsec;
 		secnum = newsecnum;
-		floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+		floor = Z_PoolMalloc (&floorpool);
 
 		P_AddThinker (&floor->thinker);
 
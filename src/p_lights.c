@@ -29,6 +29,11 @@
 // State.
 #include "r_state.h"
 
+zpool_t		flickerpool = Z_POOL(fireflicker_t, PU_LEVSPEC);
+zpool_t		flashpool = Z_POOL(lightflash_t, PU_LEVSPEC);
+zpool_t		strobepool = Z_POOL(strobe_t, PU_LEVSPEC);
+zpool_t		glowpool = Z_POOL(glow_t, PU_LEVSPEC);
+
 //
 // FIRELIGHT FLICKER
 //
@@ -66,7 +71,7 @@ void P_SpawnFireFlicker (sector_t*	sector)
     // Nothing special about it during gameplay.
     sector->special = 0; 
 	
-    flick = Z_Malloc ( sizeof(*flick), PU_LEVSPEC, 0);
+    flick = Z_PoolMalloc (&flickerpool);
 
     P_AddThinker (&flick->thinker);
 
@@ -121,7 +126,7 @@ void P_SpawnLightFlash (sector_t*	sector)
     // nothing special about it during gameplay
     sector->special = 0;	
 	
-    flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
+    flash = Z_PoolMalloc (&flashpool);
 
     P_AddThinker (&flash->thinker);
 
@@ -178,7 +183,7 @@ P_SpawnStrobeFlash
 {
     strobe_t*	flash;
 	
-    flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
+    flash = Z_PoolMalloc (&strobepool);
 
     P_AddThinker (&flash->thinker);
 
@@ -235,24 +240,23 @@ void EV_TurnTagLightsOff(line_t* line)
     sector_t*		tsec;
     line_t*		templine;
 	
-    sector = sectors;
+    j = -1;
     
-    for (j = 0;j < numsectors; j++, sector++)
+    while ((j = P_FindSectorFromLineTag(line, j)) >= 0)
     {
-	if (sector->tag == line->tag)
+	sector = &sectors[j];
+
+	min = sector->lightlevel;
+	for (i = 0;i < sector->linecount; i++)
 	{
-	    min = sector->lightlevel;
-	    for (i = 0;i < sector->linecount; i++)
-	    {
-		templine = sector->lines[i];
-		tsec = getNextSector(templine,sector);
-		if (!tsec)
-		    continue;
-		if (tsec->lightlevel < min)
-		    min = tsec->lightlevel;
-	    }
-	    sector->lightlevel = min;
+	    templine = sector->lines[i];
+	    tsec = getNextSector(templine,sector);
+	    if (!tsec)
+		continue;
+	    if (tsec->lightlevel < min)
+		min = tsec->lightlevel;
 	}
+	sector->lightlevel = min;
     }
 }
 
@@ -271,31 +275,30 @@ EV_LightTurnOn
     sector_t*	temp;
     line_t*	templine;
 	
-    sector = sectors;
+    i = -1;
 	
-    for (i=0;i<numsectors;i++, sector++)
+    while ((i = P_FindSectorFromLineTag(line, i)) >= 0)
     {
-	if (sector->tag == line->tag)
+	sector = &sectors[i];
+
+	// bright = 0 means to search
+	// for highest light level
+	// surrounding sector
+	if (!bright)
 	{
-	    // bright = 0 means to search
-	    // for highest light level
-	    // surrounding sector
-	    if (!bright)
+	    for (j = 0;j < sector->linecount; j++)
 	    {
-		for (j = 0;j < sector->linecount; j++)
-		{
-		    templine = sector->lines[j];
-		    temp = getNextSector(templine,sector);
+		templine = sector->lines[j];
+		temp = getNextSector(templine,sector);
 
-		    if (!temp)
-			continue;
+		if (!temp)
+		    continue;
 
-		    if (temp->lightlevel > bright)
-			bright = temp->lightlevel;
-		}
+		if (temp->lightlevel > bright)
+		    bright = temp->lightlevel;
 	    }
-	    sector-> lightlevel = bright;
 	}
+	sector-> lightlevel = bright;
     }
 }
 
@@ -335,7 +338,7 @@ void P_SpawnGlowingLight(sector_t*	sector)
 {
     glow_t*	g;
 	
-    g = Z_Malloc( sizeof(*g), PU_LEVSPEC, 0);
+    g = Z_PoolMalloc (&glowpool);
 
     P_AddThinker(&g->thinker);
 
@@ -22,6 +22,7 @@
 
 #ifndef __R_LOCAL__
 #include "r_local.h"
+#include "z_zone.h"
 #endif
 
 #define FLOATSPEED		(FRACUNIT*4)
@@ -100,6 +101,16 @@ extern int		itemrespawntime[ITEMQUESIZE];
 extern int		iquehead;
 extern int		iquetail;
 
+// Storage for every mobj
+extern zpool_t		mobjpool;
+
+// The mobjs of each type, in thinker list order,
+//  linked through tnext.
+extern mobj_t*		mobjsoftype[NUMMOBJTYPES];
+
+void	P_ClearMobjTypes (void);
+void	P_LinkMobjType (mobj_t* mobj);
+
 
 void P_RespawnSpecials (void);
 
@@ -176,6 +187,17 @@ void 	P_LineOpening (line_t* linedef);
 boolean P_BlockLinesIterator (int x, int y, boolean(*func)(line_t*) );
 boolean P_BlockThingsIterator (int x, int y, boolean(*func)(mobj_t*) );
 
+boolean
+P_BlockThingsNear
+( int		x,
+  int		y,
+  fixed_t	cx,
+  fixed_t	cy,
+  fixed_t	dist,
+  boolean	(*func)(mobj_t*) );
+
+void P_RefreshBlockThing (mobj_t* thing);
+
 #define PT_ADDLINES		1
 #define PT_ADDTHINGS	2
 #define PT_EARLYOUT		4
@@ -265,7 +287,34 @@ extern int		bmapwidth;
 extern int		bmapheight;	// in mapblocks
 extern fixed_t		bmaporgx;
 extern fixed_t		bmaporgy;	// origin of block map
-extern mobj_t**		blocklinks;	// for thing chains
+
+//
+// A thing linked in a block, with the fields
+// the broad phase rejects on kept beside it.
+//
+typedef struct
+{
+    fixed_t	x;
+    fixed_t	y;
+    fixed_t	radius;
+    mobj_t*	thing;
+} blockthing_t;
+
+//
+// The things whose origins lie in a block,
+// latest link last, and the block's lines.
+//
+typedef struct
+{
+    blockthing_t*	things;
+    int			numthings;
+    int			maxthings;
+
+    // line numbers, ended by -1
+    int*		lines;
+} blockcell_t;
+
+extern blockcell_t*	blockcells;	// [bmapwidth*bmapheight]
 
 
 
@@ -175,7 +175,7 @@ P_TeleportMove
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_StompThing))
+	    if (!P_BlockThingsNear(bx,by,tmx,tmy,tmthing->radius,PIT_StompThing))
 		return false;
     
     // the move is ok,
@@ -451,7 +451,7 @@ P_CheckPosition
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+	    if (!P_BlockThingsNear(bx,by,tmx,tmy,tmthing->radius,PIT_CheckThing))
 		return false;
     
     // check lines
@@ -1276,7 +1276,8 @@ P_RadiusAttack
 	
     for (y=yl ; y<=yh ; y++)
 	for (x=xl ; x<=xh ; x++)
-	    P_BlockThingsIterator (x, y, PIT_RadiusAttack );
+	    P_BlockThingsNear (x, y, spot->x, spot->y,
+			       damage<<FRACBITS, PIT_RadiusAttack );
 }
 
 
@@ -1297,6 +1298,10 @@ P_RadiusAttack
 boolean		crushchange;
 boolean		nofit;
 
+// The things being re-checked by P_ChangeSector
+static mobj_t**		changethings;
+static int		maxchangethings;
+
 
 //
 // PIT_ChangeSector
@@ -1361,25 +1366,90 @@ boolean PIT_ChangeSector (mobj_t*	thing)
 
 
 
+//
+// P_CompareBlockOrder
+// Sorts things the way a scan of the blockbox
+// would meet them: by block column, then row,
+// then latest link first.
+//
+static int P_CompareBlockOrder (const void* a, const void* b)
+{
+    const mobj_t*	thing1 = *(const mobj_t**) a;
+    const mobj_t*	thing2 = *(const mobj_t**) b;
+    int			block1;
+    int			block2;
+
+    block1 = thing1->blockcell % bmapwidth;
+    block2 = thing2->blockcell % bmapwidth;
+    if (block1 != block2)
+	return block1 - block2;
+
+    block1 = thing1->blockcell / bmapwidth;
+    block2 = thing2->blockcell / bmapwidth;
+    if (block1 != block2)
+	return block1 - block2;
+
+    return (int) (thing2->blockstamp - thing1->blockstamp);
+}
+
+
 //
 // P_ChangeSector
+// Only the things touching the sector are re-checked,
+// limited to those linked in its blockbox and visited
+// in blockmap order, so crushing plays out as before.
+// Things in the blockbox that don't touch the sector
+// keep their heights, as a re-check could only change
+// them if they were already stale.
 //
 boolean
 P_ChangeSector
 ( sector_t*	sector,
   boolean	crunch )
 {
+    msecnode_t*	node;
+    mobj_t*	thing;
+    int		numthings;
     int		x;
     int		y;
+    int		i;
 	
     nofit = false;
     crushchange = crunch;
-	
-    // re-check heights for all things near the moving sector
-    for (x=sector->blockbox[BOXLEFT] ; x<= sector->blockbox[BOXRIGHT] ; x++)
-	for (y=sector->blockbox[BOXBOTTOM];y<= sector->blockbox[BOXTOP] ; y++)
-	    P_BlockThingsIterator (x, y, PIT_ChangeSector);
-	
+
+    // gather first, as crushing spawns and removes things
+    numthings = 0;
+
+    for (node = sector->touchinglist ; node ; node = node->snext)
+    {
+	thing = node->thing;
+	x = thing->blockcell % bmapwidth;
+	y = thing->blockcell / bmapwidth;
+
+	if (x < sector->blockbox[BOXLEFT]
+	    || x > sector->blockbox[BOXRIGHT]
+	    || y < sector->blockbox[BOXBOTTOM]
+	    || y > sector->blockbox[BOXTOP])
+	    continue;
+
+	if (numthings == maxchangethings)
+	{
+	    maxchangethings = maxchangethings ? maxchangethings * 2 : 64;
+	    changethings = realloc(changethings,
+				   maxchangethings * sizeof(*changethings));
+
+	    if (!changethings)
+		I_Error ("P_ChangeSector: out of memory");
+	}
+
+	changethings[numthings++] = thing;
+    }
+
+    qsort(changethings, numthings, sizeof(*changethings), P_CompareBlockOrder);
+
+    // re-check heights for all things touching the moving sector
+    for (i=0 ; i<numthings ; i++)
+	PIT_ChangeSector (changethings[i]);
 	
     return nofit;
 }
@@ -331,6 +331,217 @@ void P_LineOpening (line_t* linedef)
 // THING POSITION SETTING
 //
 
+// Storage for the touching links
+static zpool_t		secnodepool = Z_POOL(msecnode_t, PU_LEVEL);
+
+// Counts links into the blockmap
+static unsigned int	blockstamp;
+
+
+//
+// P_TouchSector
+// Adds sec to the sectors the thing touches,
+// unless it is already there.
+//
+static void P_TouchSector (mobj_t* thing, sector_t* sec)
+{
+    msecnode_t*	node;
+
+    for (node = thing->touchinglist ; node ; node = node->tnext)
+    {
+	if (node->sector == sec)
+	    return;
+    }
+
+    node = Z_PoolMalloc (&secnodepool);
+    node->sector = sec;
+    node->thing = thing;
+    node->tnext = thing->touchinglist;
+    thing->touchinglist = node;
+
+    node->sprev = NULL;
+    node->snext = sec->touchinglist;
+    if (sec->touchinglist)
+	sec->touchinglist->sprev = node;
+    sec->touchinglist = node;
+}
+
+
+//
+// P_LinkTouching
+// Links the thing to its own sector and to both sides
+// of every line crossing its box, the same lines
+// P_CheckPosition takes the floor and ceiling from.
+// Lines in several blocks are simply tested again,
+// as validcount may be in use by a caller.
+//
+static void P_LinkTouching (mobj_t* thing)
+{
+    fixed_t	box[4];
+    int		xl;
+    int		xh;
+    int		yl;
+    int		yh;
+    int		bx;
+    int		by;
+    int*	list;
+    line_t*	ld;
+
+    thing->touchinglist = NULL;
+    P_TouchSector (thing, thing->subsector->sector);
+
+    box[BOXTOP] = thing->y + thing->radius;
+    box[BOXBOTTOM] = thing->y - thing->radius;
+    box[BOXRIGHT] = thing->x + thing->radius;
+    box[BOXLEFT] = thing->x - thing->radius;
+
+    xl = (box[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+    xh = (box[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+    yl = (box[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+    yh = (box[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+
+    if (xl < 0)
+	xl = 0;
+    if (yl < 0)
+	yl = 0;
+    if (xh >= bmapwidth)
+	xh = bmapwidth - 1;
+    if (yh >= bmapheight)
+	yh = bmapheight - 1;
+
+    for (bx=xl ; bx<=xh ; bx++)
+    {
+	for (by=yl ; by<=yh ; by++)
+	{
+	    for (list = blockcells[by*bmapwidth+bx].lines ; *list != -1 ; list++)
+	    {
+		ld = &lines[*list];
+
+		if (box[BOXRIGHT] <= ld->bbox[BOXLEFT]
+		    || box[BOXLEFT] >= ld->bbox[BOXRIGHT]
+		    || box[BOXTOP] <= ld->bbox[BOXBOTTOM]
+		    || box[BOXBOTTOM] >= ld->bbox[BOXTOP])
+		    continue;
+
+		if (P_BoxOnLineSide (box, ld) != -1)
+		    continue;
+
+		P_TouchSector (thing, ld->frontsector);
+		if (ld->backsector)
+		    P_TouchSector (thing, ld->backsector);
+	    }
+	}
+    }
+}
+
+
+//
+// P_UnlinkTouching
+//
+static void P_UnlinkTouching (mobj_t* thing)
+{
+    msecnode_t*	node;
+    msecnode_t*	next;
+
+    for (node = thing->touchinglist ; node ; node = next)
+    {
+	next = node->tnext;
+
+	if (node->snext)
+	    node->snext->sprev = node->sprev;
+
+	if (node->sprev)
+	    node->sprev->snext = node->snext;
+	else
+	    node->sector->touchinglist = node->snext;
+
+	Z_PoolFree (node);
+    }
+
+    thing->touchinglist = NULL;
+}
+
+
+//
+// P_AddBlockThing
+// Links the thing last into its block,
+// growing the block's array as needed.
+//
+static void P_AddBlockThing (mobj_t* thing)
+{
+    blockcell_t*	cell;
+    blockthing_t*	things;
+    blockthing_t*	bt;
+
+    cell = &blockcells[thing->blockcell];
+
+    if (cell->numthings == cell->maxthings)
+    {
+	cell->maxthings = cell->maxthings ? cell->maxthings * 2 : 4;
+	things = Z_Malloc (cell->maxthings * sizeof(*things), PU_LEVEL, NULL);
+
+	if (cell->things)
+	{
+	    memcpy (things, cell->things, cell->numthings * sizeof(*things));
+	    Z_Free (cell->things);
+	}
+
+	cell->things = things;
+    }
+
+    bt = &cell->things[cell->numthings++];
+    bt->x = thing->x;
+    bt->y = thing->y;
+    bt->radius = thing->radius;
+    bt->thing = thing;
+}
+
+
+//
+// P_FindBlockThing
+// Where the thing is in its block, searching down from i,
+// or -1 if it isn't there.
+//
+static int P_FindBlockThing (blockcell_t* cell, mobj_t* thing, int i)
+{
+    if (i >= cell->numthings)
+	i = cell->numthings - 1;
+
+    for ( ; i >= 0 ; i--)
+    {
+	if (cell->things[i].thing == thing)
+	    break;
+    }
+
+    return i;
+}
+
+
+//
+// P_RefreshBlockThing
+// Updates the copy of the position the blockmap keeps
+// for a thing moved without relinking.
+// It stays in the block it was linked into.
+//
+void P_RefreshBlockThing (mobj_t* thing)
+{
+    blockcell_t*	cell;
+    int			i;
+
+    if (thing->blockcell < 0)
+	return;
+
+    cell = &blockcells[thing->blockcell];
+    i = P_FindBlockThing (cell, thing, cell->numthings - 1);
+
+    if (i >= 0)
+    {
+	cell->things[i].x = thing->x;
+	cell->things[i].y = thing->y;
+	cell->things[i].radius = thing->radius;
+    }
+}
+
 
 //
 // P_UnsetThingPosition
@@ -341,8 +552,8 @@ void P_LineOpening (line_t* linedef)
 //
 void P_UnsetThingPosition (mobj_t* thing)
 {
-    int		blockx;
-    int		blocky;
+    blockcell_t*	cell;
+    int			i;
 
     if ( ! (thing->flags & MF_NOSECTOR) )
     {
@@ -360,24 +571,25 @@ void P_UnsetThingPosition (mobj_t* thing)
     if ( ! (thing->flags & MF_NOBLOCKMAP) )
     {
 	// inert things don't need to be in blockmap
-	// unlink from block map
-	if (thing->bnext)
-	    thing->bnext->bprev = thing->bprev;
-	
-	if (thing->bprev)
-	    thing->bprev->bnext = thing->bnext;
-	else
+	// unlink from block map, keeping the order
+	if (thing->blockcell >= 0)
 	{
-	    blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
-	    blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
+	    cell = &blockcells[thing->blockcell];
+	    i = P_FindBlockThing (cell, thing, cell->numthings - 1);
 
-	    if (blockx>=0 && blockx < bmapwidth
-		&& blocky>=0 && blocky <bmapheight)
+	    if (i >= 0)
 	    {
-		blocklinks[blocky*bmapwidth+blockx] = thing->bnext;
+		cell->numthings--;
+		memmove (&cell->things[i], &cell->things[i+1],
+			 (cell->numthings - i) * sizeof(*cell->things));
 	    }
+
+	    thing->blockcell = -1;
 	}
     }
+
+    if (thing->touchinglist)
+	P_UnlinkTouching (thing);
 }
 
 
@@ -394,7 +606,6 @@ P_SetThingPosition (mobj_t* thing)
     sector_t*		sec;
     int			blockx;
     int			blocky;
-    mobj_t**		link;
 
     
     // link into subsector
@@ -417,6 +628,9 @@ P_SetThingPosition (mobj_t* thing)
 
     
     // link into blockmap
+    thing->blockcell = -1;
+    thing->touchinglist = NULL;
+
     if ( ! (thing->flags & MF_NOBLOCKMAP) )
     {
 	// inert things don't need to be in blockmap		
@@ -428,19 +642,15 @@ P_SetThingPosition (mobj_t* thing)
 	    && blocky>=0
 	    && blocky < bmapheight)
 	{
-	    link = &blocklinks[blocky*bmapwidth+blockx];
-	    thing->bprev = NULL;
-	    thing->bnext = *link;
-	    if (*link)
-		(*link)->bprev = thing;
+	    thing->blockcell = blocky*bmapwidth+blockx;
+	    thing->blockstamp = ++blockstamp;
+	    P_AddBlockThing (thing);
 
-	    *link = thing;
-	}
-	else
-	{
-	    // thing is off the map
-	    thing->bnext = thing->bprev = NULL;
+	    // only things in the blockmap are height clipped
+	    P_LinkTouching (thing);
 	}
+
+	// else thing is off the map
     }
 }
 
@@ -469,8 +679,7 @@ P_BlockLinesIterator
   int			y,
   boolean(*func)(line_t*) )
 {
-    int			offset;
-    short*		list;
+    int*		list;
     line_t*		ld;
 	
     if (x<0
@@ -481,11 +690,7 @@ P_BlockLinesIterator
 	return true;
     }
     
-    offset = y*bmapwidth+x;
-	
-    offset = *(blockmap+offset);
-
-    for ( list = blockmaplump+offset ; *list != -1 ; list++)
+    for ( list = blockcells[y*bmapwidth+x].lines ; *list != -1 ; list++)
     {
 	ld = &lines[*list];
 
@@ -501,8 +706,33 @@ P_BlockLinesIterator
 }
 
 
+//
+// P_ResumeBlockThings
+// The function may link and unlink things, in this
+// block too. Returns where mobj is now, so the walk
+// goes on with the thing linked before it, or where
+// it was if it got unlinked. Things linked since
+// are above and not visited.
+//
+static int P_ResumeBlockThings (blockcell_t* cell, mobj_t* mobj, int i)
+{
+    int		j;
+
+    if (i < cell->numthings && cell->things[i].thing == mobj)
+	return i;
+
+    j = P_FindBlockThing (cell, mobj, i);
+
+    if (j >= 0)
+	return j;
+
+    return i < cell->numthings ? i : cell->numthings;
+}
+
+
 //
 // P_BlockThingsIterator
+// Latest links first.
 //
 boolean
 P_BlockThingsIterator
@@ -510,7 +740,53 @@ P_BlockThingsIterator
   int			y,
   boolean(*func)(mobj_t*) )
 {
+    blockcell_t*	cell;
+    mobj_t*		mobj;
+    int			i;
+	
+    if ( x<0
+	 || y<0
+	 || x>=bmapwidth
+	 || y>=bmapheight)
+    {
+	return true;
+    }
+    
+    cell = &blockcells[y*bmapwidth+x];
+
+    for (i = cell->numthings - 1 ; i >= 0 ; i--)
+    {
+	mobj = cell->things[i].thing;
+
+	if (!func( mobj ) )
+	    return false;
+
+	i = P_ResumeBlockThings (cell, mobj, i);
+    }
+    return true;
+}
+
+
+//
+// P_BlockThingsNear
+// As P_BlockThingsIterator, but skips the things
+// whose boxes end dist or more from (cx,cy) on
+// either axis, without loading them.
+// The function must reject those itself anyway.
+//
+boolean
+P_BlockThingsNear
+( int		x,
+  int		y,
+  fixed_t	cx,
+  fixed_t	cy,
+  fixed_t	dist,
+  boolean	(*func)(mobj_t*) )
+{
+    blockcell_t*	cell;
+    blockthing_t*	bt;
     mobj_t*		mobj;
+    int			i;
 	
     if ( x<0
 	 || y<0
@@ -520,13 +796,24 @@ P_BlockThingsIterator
 	return true;
     }
     
+    cell = &blockcells[y*bmapwidth+x];
 
-    for (mobj = blocklinks[y*bmapwidth+x] ;
-	 mobj ;
-	 mobj = mobj->bnext)
+    for (i = cell->numthings - 1 ; i >= 0 ; i--)
     {
+	bt = &cell->things[i];
+
+	if ( abs(bt->x - cx) >= bt->radius + dist
+	     || abs(bt->y - cy) >= bt->radius + dist )
+	{
+	    continue;
+	}
+
+	mobj = bt->thing;
+
 	if (!func( mobj ) )
 	    return false;
+
+	i = P_ResumeBlockThings (cell, mobj, i);
     }
     return true;
 }
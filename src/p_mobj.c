@@ -37,6 +37,59 @@
 void G_PlayerReborn (int player);
 void P_SpawnMapThing (mapthing_t*	mthing);
 
+zpool_t		mobjpool = Z_POOL(mobj_t, PU_LEVEL);
+
+mobj_t*		mobjsoftype[NUMMOBJTYPES];
+static mobj_t*	lastoftype[NUMMOBJTYPES];
+
+
+//
+// P_ClearMobjTypes
+// Empties the lists of mobjs by type, with the thinker list.
+//
+void P_ClearMobjTypes (void)
+{
+    memset (mobjsoftype, 0, sizeof(mobjsoftype));
+    memset (lastoftype, 0, sizeof(lastoftype));
+}
+
+
+//
+// P_LinkMobjType
+// Appends a mobj to the list of its type. Mobjs are added to
+//  the thinker list at the same time, so the orders match.
+//
+void P_LinkMobjType (mobj_t* mobj)
+{
+    mobj->tnext = NULL;
+    mobj->tprev = lastoftype[mobj->type];
+
+    if (mobj->tprev)
+	mobj->tprev->tnext = mobj;
+    else
+	mobjsoftype[mobj->type] = mobj;
+
+    lastoftype[mobj->type] = mobj;
+}
+
+
+//
+// P_UnlinkMobjType
+//
+static void P_UnlinkMobjType (mobj_t* mobj)
+{
+    if (mobj->tprev)
+	mobj->tprev->tnext = mobj->tnext;
+    else
+	mobjsoftype[mobj->type] = mobj->tnext;
+
+    if (mobj->tnext)
+	mobj->tnext->tprev = mobj->tprev;
+    else
+	lastoftype[mobj->type] = mobj->tprev;
+}
+
+
 
 //
 // P_SetMobjState
@@ -513,7 +566,7 @@ P_SpawnMobj
     state_t*	st;
     mobjinfo_t*	info;
 	
-    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+    mobj = Z_PoolMalloc (&mobjpool);
     memset (mobj, 0, sizeof (*mobj));
     info = &mobjinfo[type];
 	
@@ -555,6 +608,7 @@ P_SpawnMobj
     mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
 	
     P_AddThinker (&mobj->thinker);
+    P_LinkMobjType (mobj);
 
     return mobj;
 }
@@ -591,6 +645,8 @@ void P_RemoveMobj (mobj_t* mobj)
     // stop any playing sound
     S_StopSound (mobj);
     
+    P_UnlinkMobjType (mobj);
+
     // free block
     P_RemoveThinker ((thinker_t*)mobj);
 }
@@ -915,6 +971,7 @@ void P_CheckMissileSpawn (mobj_t* th)
     th->x += (th->momx>>1);
     th->y += (th->momy>>1);
     th->z += (th->momz>>1);
+    P_RefreshBlockThing (th);
 
     if (!P_TryMove (th, th->x, th->y))
 	P_ExplodeMissile (th);
@@ -208,6 +208,22 @@ typedef struct mobj_s
     fixed_t		y;
     fixed_t		z;
 
+    // The fields every mobj's thinker reads each tic
+    // follow the position, to share its cache line.
+
+    // Momentums, used to update position.
+    fixed_t		momx;
+    fixed_t		momy;
+    fixed_t		momz;
+
+    // The closest interval over all contacted Sectors.
+    fixed_t		floorz;
+    fixed_t		ceilingz;
+
+    int			tics;	// state tic counter
+    state_t*		state;
+    int			flags;
+
     // More list: links in sector (if needed)
     struct mobj_s*	snext;
     struct mobj_s*	sprev;
@@ -218,34 +234,28 @@ typedef struct mobj_s
     int			frame;	// might be ORed with FF_FULLBRIGHT
 
     // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s*	bnext;
-    struct mobj_s*	bprev;
+    // Block linked in (if any, else -1).
+    int			blockcell;
+
+    // When the mobj was linked into its block;
+    // later links are visited first.
+    unsigned int	blockstamp;
+
+    // Sectors the mobj's box overlaps (if in blockmap).
+    struct msecnode_s*	touchinglist;
     
     struct subsector_s*	subsector;
 
-    // The closest interval over all contacted Sectors.
-    fixed_t		floorz;
-    fixed_t		ceilingz;
-
     // For movement checking.
     fixed_t		radius;
     fixed_t		height;	
 
-    // Momentums, used to update position.
-    fixed_t		momx;
-    fixed_t		momy;
-    fixed_t		momz;
-
     // If == validcount, already checked.
     int			validcount;
 
     mobjtype_t		type;
     mobjinfo_t*		info;	// &mobjinfo[mobj->type]
     
-    int			tics;	// state tic counter
-    state_t*		state;
-    int			flags;
     int			health;
 
     // Movement direction, movement generation (zig-zagging).
@@ -276,6 +286,10 @@ typedef struct mobj_s
 
     // Thing being chased/attacked for tracers.
     struct mobj_s*	tracer;	
+
+    // Links in the list of mobjs of its type.
+    struct mobj_s*	tnext;
+    struct mobj_s*	tprev;
     
 } mobj_t;
 
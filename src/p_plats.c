@@ -37,6 +37,8 @@
 
 plat_t*		activeplats[MAXPLATS];
 
+zpool_t		platpool = Z_POOL(plat_t, PU_LEVSPEC);
+
 
 
 //
@@ -160,7 +162,7 @@ EV_DoPlat
 	
 	// Find lowest & highest floors around sector
 	rtn = 1;
-	plat = Z_Malloc( sizeof(*plat), PU_LEVSPEC, 0);
+	plat = Z_PoolMalloc (&platpool);
 	P_AddThinker(&plat->thinker);
 		
 	plat->type = type;
@@ -330,10 +330,10 @@ static void saveg_read_mobj_t(mobj_t *str)
     str->frame = saveg_read32();
 
     // struct mobj_s* bnext;
-    str->bnext = saveg_readp();
+    saveg_readp();
 
     // struct mobj_s* bprev;
-    str->bprev = saveg_readp();
+    saveg_readp();
 
     // struct subsector_s* subsector;
     str->subsector = saveg_readp();
@@ -448,10 +448,10 @@ static void saveg_write_mobj_t(mobj_t *str)
     saveg_write32(str->frame);
 
     // struct mobj_s* bnext;
-    saveg_writep(str->bnext);
+    saveg_writep(NULL);
 
     // struct mobj_s* bprev;
-    saveg_writep(str->bprev);
+    saveg_writep(NULL);
 
     // struct subsector_s* subsector;
     saveg_writep(str->subsector);
@@ -1550,6 +1550,9 @@ void P_UnArchiveWorld (void)
 	sec->specialdata = 0;
 	sec->soundtarget = 0;
     }
+
+    // the tags may differ from the map's
+    P_IndexSectorTags ();
     
     // do lines
     for (i=0, li = lines ; i<numlines ; i++,li++)
@@ -1633,7 +1636,7 @@ void P_UnArchiveThinkers (void)
 	if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
 	    P_RemoveMobj ((mobj_t *)currentthinker);
 	else
-	    Z_Free (currentthinker);
+	    Z_PoolFree (currentthinker);
 
 	currentthinker = next;
     }
@@ -1650,7 +1653,7 @@ void P_UnArchiveThinkers (void)
 			
 	  case tc_mobj:
 	    saveg_read_pad();
-	    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+	    mobj = Z_PoolMalloc (&mobjpool);
             saveg_read_mobj_t(mobj);
 
 	    mobj->target = NULL;
@@ -1661,6 +1664,7 @@ void P_UnArchiveThinkers (void)
 	    mobj->ceilingz = mobj->subsector->sector->ceilingheight;
 	    mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
 	    P_AddThinker (&mobj->thinker);
+	    P_LinkMobjType (mobj);
 	    break;
 
 	  default:
@@ -1814,7 +1818,7 @@ void P_UnArchiveSpecials (void)
 			
 	  case tc_ceiling:
 	    saveg_read_pad();
-	    ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
+	    ceiling = Z_PoolMalloc (&ceilingpool);
             saveg_read_ceiling_t(ceiling);
 	    ceiling->sector->specialdata = ceiling;
 
@@ -1827,7 +1831,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_door:
 	    saveg_read_pad();
-	    door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
+	    door = Z_PoolMalloc (&doorpool);
             saveg_read_vldoor_t(door);
 	    door->sector->specialdata = door;
 	    door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
@@ -1836,7 +1840,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_floor:
 	    saveg_read_pad();
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
+	    floor = Z_PoolMalloc (&floorpool);
             saveg_read_floormove_t(floor);
 	    floor->sector->specialdata = floor;
 	    floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -1845,7 +1849,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_plat:
 	    saveg_read_pad();
-	    plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
+	    plat = Z_PoolMalloc (&platpool);
             saveg_read_plat_t(plat);
 	    plat->sector->specialdata = plat;
 
@@ -1858,7 +1862,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_flash:
 	    saveg_read_pad();
-	    flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
+	    flash = Z_PoolMalloc (&flashpool);
             saveg_read_lightflash_t(flash);
 	    flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
 	    P_AddThinker (&flash->thinker);
@@ -1866,7 +1870,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_strobe:
 	    saveg_read_pad();
-	    strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
+	    strobe = Z_PoolMalloc (&strobepool);
             saveg_read_strobe_t(strobe);
 	    strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
 	    P_AddThinker (&strobe->thinker);
@@ -1874,7 +1878,7 @@ void P_UnArchiveSpecials (void)
 				
 	  case tc_glow:
 	    saveg_read_pad();
-	    glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
+	    glow = Z_PoolMalloc (&glowpool);
             saveg_read_glow_t(glow);
 	    glow->thinker.function.acp1 = (actionf_p1)T_Glow;
 	    P_AddThinker (&glow->thinker);
@@ -87,8 +87,8 @@ short*		blockmaplump;
 // origin of block map
 fixed_t		bmaporgx;
 fixed_t		bmaporgy;
-// for thing chains
-mobj_t**	blocklinks;		
+// things and decoded lines of each block
+blockcell_t*	blockcells;
 
 
 // REJECT
@@ -506,6 +506,9 @@ void P_LoadBlockMap (int lump)
     int i;
     int count;
     int lumplen;
+    int total;
+    short* list;
+    int* celllines;
 
     lumplen = W_LumpLength(lump);
     count = lumplen / 2;
@@ -528,11 +531,32 @@ void P_LoadBlockMap (int lump)
     bmapwidth = blockmaplump[2];
     bmapheight = blockmaplump[3];
 	
-    // Clear out mobj chains
+    // Clear out the things
 
-    count = sizeof(*blocklinks) * bmapwidth * bmapheight;
-    blocklinks = Z_Malloc(count, PU_LEVEL, 0);
-    memset(blocklinks, 0, count);
+    count = bmapwidth * bmapheight;
+    blockcells = Z_Malloc(count * sizeof(*blockcells), PU_LEVEL, 0);
+    memset(blockcells, 0, count * sizeof(*blockcells));
+
+    // Decode each block's line list, terminator included
+
+    total = 0;
+    for (i=0; i<count; i++)
+    {
+	for (list = blockmaplump + blockmap[i]; *list != -1; list++)
+	    total++;
+	total++;
+    }
+
+    celllines = Z_Malloc(total * sizeof(*celllines), PU_LEVEL, 0);
+
+    for (i=0; i<count; i++)
+    {
+	blockcells[i].lines = celllines;
+
+	for (list = blockmaplump + blockmap[i]; *list != -1; list++)
+	    *celllines++ = *list;
+	*celllines++ = -1;
+    }
 }
 
 
@@ -804,6 +828,7 @@ P_SetupLevel
     P_LoadSegs (lumpnum+ML_SEGS);
 
     P_GroupLines ();
+    P_IndexSectorTags ();
     P_LoadReject (lumpnum+ML_REJECT);
 
     bodyqueslot = 0;
@@ -437,6 +437,47 @@ fixed_t	P_FindHighestCeilingSurrounding(sector_t* sec)
 
 
 
+//
+// Sector numbers sorted by tag, and by number within a tag,
+//  so the sectors a tag refers to are found by binary search.
+//
+static int*	tagsectors;
+
+
+static int P_CompareSectorTags (const void* a, const void* b)
+{
+    int		sa = *(const int *) a;
+    int		sb = *(const int *) b;
+
+    if (sectors[sa].tag != sectors[sb].tag)
+	return sectors[sa].tag < sectors[sb].tag ? -1 : 1;
+
+    return sa - sb;
+}
+
+
+//
+// P_IndexSectorTags
+// Called by P_SetupLevel once the sectors are loaded,
+// and again when a savegame has replaced their tags.
+//
+void P_IndexSectorTags (void)
+{
+    int		i;
+
+    // the level's zone frees clear tagsectors
+    if (tagsectors)
+	Z_Free (tagsectors);
+
+    tagsectors = Z_Malloc (numsectors * sizeof(*tagsectors), PU_LEVEL, &tagsectors);
+
+    for (i=0 ; i<numsectors ; i++)
+	tagsectors[i] = i;
+
+    qsort (tagsectors, numsectors, sizeof(*tagsectors), P_CompareSectorTags);
+}
+
+
 //
 // RETURN NEXT SECTOR # THAT LINE TAG REFERS TO
 //
@@ -445,11 +486,30 @@ P_FindSectorFromLineTag
 ( line_t*	line,
   int		start )
 {
-    int	i;
+    int		low;
+    int		high;
+    int		mid;
+    int		sec;
 	
-    for (i=start+1;i<numsectors;i++)
-	if (sectors[i].tag == line->tag)
-	    return i;
+    // Find the first sector after start with the tag,
+    //  or the first one past it in the index.
+    low = 0;
+    high = numsectors;
+
+    while (low < high)
+    {
+	mid = (low + high) / 2;
+	sec = tagsectors[mid];
+
+	if (sectors[sec].tag < line->tag
+	    || (sectors[sec].tag == line->tag && sec <= start))
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+
+    if (low < numsectors && sectors[tagsectors[low]].tag == line->tag)
+	return tagsectors[low];
     
     return -1;
 }
@@ -1325,7 +1385,7 @@ int EV_DoDonut(line_t*	line)
             }
 
 	    //	Spawn rising slime
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	    floor = Z_PoolMalloc (&floorpool);
 	    P_AddThinker (&floor->thinker);
 	    s2->specialdata = floor;
 	    floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -1339,7 +1399,7 @@ int EV_DoDonut(line_t*	line)
 	    floor->floordestheight = s3_floorheight;
 	    
 	    //	Spawn lowering donut-hole
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	    floor = Z_PoolMalloc (&floorpool);
 	    P_AddThinker (&floor->thinker);
 	    s1->specialdata = floor;
 	    floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
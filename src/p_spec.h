@@ -92,6 +92,8 @@ P_FindNextHighestFloor
 fixed_t P_FindLowestCeilingSurrounding(sector_t* sec);
 fixed_t P_FindHighestCeilingSurrounding(sector_t* sec);
 
+void P_IndexSectorTags (void);
+
 int
 P_FindSectorFromLineTag
 ( line_t*	line,
@@ -128,6 +130,8 @@ typedef struct
     
 } fireflicker_t;
 
+extern zpool_t	flickerpool;
+
 
 
 typedef struct
@@ -142,6 +146,8 @@ typedef struct
     
 } lightflash_t;
 
+extern zpool_t	flashpool;
+
 
 
 typedef struct
@@ -156,6 +162,8 @@ typedef struct
     
 } strobe_t;
 
+extern zpool_t	strobepool;
+
 
 
 
@@ -169,6 +177,8 @@ typedef struct
 
 } glow_t;
 
+extern zpool_t	glowpool;
+
 
 #define GLOWSPEED			8
 #define STROBEBRIGHT		5
@@ -296,6 +306,8 @@ typedef struct
     
 } plat_t;
 
+extern zpool_t	platpool;
+
 
 
 #define PLATWAIT		3
@@ -356,6 +368,8 @@ typedef struct
     
 } vldoor_t;
 
+extern zpool_t	doorpool;
+
 
 
 #define VDOORSPEED		FRACUNIT*2
@@ -506,6 +520,8 @@ typedef struct
     
 } ceiling_t;
 
+extern zpool_t	ceilingpool;
+
 
 
 
@@ -592,6 +608,8 @@ typedef struct
 
 } floormove_t;
 
+extern zpool_t	floorpool;
+
 
 
 #define FLOORSPEED		FRACUNIT
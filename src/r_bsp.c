@@ -21,13 +21,17 @@
 
 #include "doomdef.h"
 
+#include <stdlib.h>
+
 #include "m_bbox.h"
 
 #include "i_system.h"
 
 #include "r_main.h"
+#include "r_bsp.h"
 #include "r_plane.h"
 #include "r_things.h"
+#include "r_draw.h"
 
 // State.
 #include "doomstat.h"
@@ -37,14 +41,29 @@
 
 
 
-seg_t*		curline;
-side_t*		sidedef;
-line_t*		linedef;
-sector_t*	frontsector;
-sector_t*	backsector;
+THREADLOCAL seg_t*		curline;
+THREADLOCAL side_t*		sidedef;
+THREADLOCAL line_t*		linedef;
+THREADLOCAL sector_t*	frontsector;
+THREADLOCAL sector_t*	backsector;
+
+THREADLOCAL drawseg_t*	drawsegs;
+THREADLOCAL drawseg_t*	ds_p;
+static THREADLOCAL int	numdrawsegs;
+
+THREADLOCAL dsblock_t	dsblocks[DSBLOCKS];
 
-drawseg_t	drawsegs[MAXDRAWSEGS];
-drawseg_t*	ds_p;
+// Sectors and sides the last walk reached, by number,
+//  and the frame each was last listed in.
+int*			seensectors;
+int			numseensectors;
+int*			seensides;
+int			numseensides;
+
+static int*		sectorframes;
+static int*		sideframes;
+static int		maxseensectors;
+static int		maxseensides;
 
 
 void
@@ -55,12 +74,156 @@ R_StoreWallRange
 
 
 
+//
+// R_ClearSeen
+// Starts the lists of sectors and sides reached,
+//  sized for the current level.
+//
+void R_ClearSeen (void)
+{
+    if (maxseensectors < numsectors)
+    {
+	free (seensectors);
+	free (sectorframes);
+	maxseensectors = numsectors;
+	seensectors = malloc(maxseensectors * sizeof(*seensectors));
+	sectorframes = calloc(maxseensectors, sizeof(*sectorframes));
+
+	if (!seensectors || !sectorframes)
+	    I_Error ("R_ClearSeen: out of memory");
+    }
+
+    if (maxseensides < numsides)
+    {
+	free (seensides);
+	free (sideframes);
+	maxseensides = numsides;
+	seensides = malloc(maxseensides * sizeof(*seensides));
+	sideframes = calloc(maxseensides, sizeof(*sideframes));
+
+	if (!seensides || !sideframes)
+	    I_Error ("R_ClearSeen: out of memory");
+    }
+
+    numseensectors = 0;
+    numseensides = 0;
+}
+
+
+//
+// R_SeeSector
+// Lists a sector the walk reached, once per frame.
+// Only the first strip lists, as every strip walks
+//  the same nodes.
+//
+static void R_SeeSector (sector_t* sec)
+{
+    int		num;
+
+    if (!reuseview || stripx1 != 0)
+	return;
+
+    num = sec - sectors;
+
+    if (sectorframes[num] != framecount)
+    {
+	sectorframes[num] = framecount;
+	seensectors[numseensectors++] = num;
+    }
+}
+
+
+//
+// R_SeeSide
+//
+static void R_SeeSide (side_t* side)
+{
+    int		num;
+
+    if (!reuseview || stripx1 != 0)
+	return;
+
+    num = side - sides;
+
+    if (sideframes[num] != framecount)
+    {
+	sideframes[num] = framecount;
+	seensides[numseensides++] = num;
+    }
+}
+
+
 //
 // R_ClearDrawSegs
 //
 void R_ClearDrawSegs (void)
 {
+    int		i;
+
+    if (!drawsegs)
+    {
+	numdrawsegs = MAXDRAWSEGS;
+	drawsegs = malloc(numdrawsegs * sizeof(*drawsegs));
+
+	if (!drawsegs)
+	    I_Error ("R_ClearDrawSegs: out of memory");
+    }
+
     ds_p = drawsegs;
+
+    for (i=0 ; i<DSBLOCKS ; i++)
+	dsblocks[i].numsegs = 0;
+}
+
+
+//
+// R_CheckDrawSegs
+// Makes room for one more drawseg at ds_p.
+//
+void R_CheckDrawSegs (void)
+{
+    int		count;
+
+    count = ds_p - drawsegs;
+
+    if (count < numdrawsegs)
+	return;
+
+    numdrawsegs *= 2;
+    drawsegs = realloc(drawsegs, numdrawsegs * sizeof(*drawsegs));
+
+    if (!drawsegs)
+	I_Error ("R_CheckDrawSegs: out of memory (%i drawsegs)", numdrawsegs);
+
+    ds_p = drawsegs + count;
+}
+
+
+//
+// R_IndexDrawSeg
+// Adds a finished drawseg to the blocks of columns it covers.
+//
+void R_IndexDrawSeg (drawseg_t* ds)
+{
+    int		i;
+    dsblock_t*	block;
+
+    for (i = ds->x1 >> DSBLOCKSHIFT ; i <= ds->x2 >> DSBLOCKSHIFT ; i++)
+    {
+	block = &dsblocks[i];
+
+	if (block->numsegs == block->maxsegs)
+	{
+	    block->maxsegs = block->maxsegs ? block->maxsegs*2 : 64;
+	    block->segs = realloc(block->segs,
+				  block->maxsegs * sizeof(*block->segs));
+
+	    if (!block->segs)
+		I_Error ("R_IndexDrawSeg: out of memory");
+	}
+
+	block->segs[block->numsegs++] = ds - drawsegs;
+    }
 }
 
 
@@ -81,8 +244,8 @@ typedef	struct
 #define MAXSEGS		32
 
 // newend is one past the last valid seg
-cliprange_t*	newend;
-cliprange_t	solidsegs[MAXSEGS];
+THREADLOCAL cliprange_t*	newend;
+THREADLOCAL cliprange_t	solidsegs[MAXSEGS];
 
 
 
@@ -312,6 +475,11 @@ void R_AddLine (seg_t*	line)
 	
     backsector = line->backsector;
 
+    R_SeeSide (line->sidedef);
+
+    if (backsector)
+	R_SeeSector (backsector);
+
     // Single sided line?
     if (!backsector)
 	goto clipsolid;		
@@ -506,6 +674,8 @@ void R_Subsector (int num)
     count = sub->numlines;
     line = &segs[sub->firstline];
 
+    R_SeeSector (frontsector);
+
     if (frontsector->floorheight < viewz)
     {
 	floorplane = R_FindPlane (frontsector->floorheight,
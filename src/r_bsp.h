@@ -22,25 +22,48 @@
 
 
 
-extern seg_t*		curline;
-extern side_t*		sidedef;
-extern line_t*		linedef;
-extern sector_t*	frontsector;
-extern sector_t*	backsector;
+extern THREADLOCAL seg_t*		curline;
+extern THREADLOCAL side_t*		sidedef;
+extern THREADLOCAL line_t*		linedef;
+extern THREADLOCAL sector_t*	frontsector;
+extern THREADLOCAL sector_t*	backsector;
 
-extern int		rw_x;
-extern int		rw_stopx;
+extern THREADLOCAL int		rw_x;
+extern THREADLOCAL int		rw_stopx;
 
-extern boolean		segtextured;
+extern THREADLOCAL boolean		segtextured;
 
 // false if the back side is the same plane
-extern boolean		markfloor;		
-extern boolean		markceiling;
+extern THREADLOCAL boolean		markfloor;		
+extern THREADLOCAL boolean		markceiling;
 
 extern boolean		skymap;
 
-extern drawseg_t	drawsegs[MAXDRAWSEGS];
-extern drawseg_t*	ds_p;
+extern THREADLOCAL drawseg_t*	drawsegs;
+extern THREADLOCAL drawseg_t*	ds_p;
+
+//
+// Drawsegs that can clip sprites, listed for each block of
+//  screen columns they cover, by index in the order stored.
+//
+#define DSBLOCKSHIFT		5
+#define DSBLOCKS		((SCREENWIDTH + (1<<DSBLOCKSHIFT) - 1) >> DSBLOCKSHIFT)
+
+typedef struct
+{
+    int*	segs;
+    int		numsegs;
+    int		maxsegs;
+
+} dsblock_t;
+
+extern THREADLOCAL dsblock_t	dsblocks[DSBLOCKS];
+
+// Sectors and sides the last walk reached, by number.
+extern int*		seensectors;
+extern int		numseensectors;
+extern int*		seensides;
+extern int		numseensides;
 
 extern lighttable_t**	hscalelight;
 extern lighttable_t**	vscalelight;
@@ -52,7 +75,10 @@ typedef void (*drawfunc_t) (int start, int stop);
 
 // BSP?
 void R_ClearClipSegs (void);
+void R_ClearSeen (void);
 void R_ClearDrawSegs (void);
+void R_CheckDrawSegs (void);
+void R_IndexDrawSeg (drawseg_t* ds);
 
 
 void R_RenderBSPNode (int bspnum);
@@ -17,7 +17,9 @@
 //	generation of lookups, caching, retrieval by name.
 //
 
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "deh_main.h"
 #include "i_swap.h"
@@ -148,7 +150,8 @@ int*			texturewidthmask;
 fixed_t*		textureheight;		
 int*			texturecompositesize;
 short**			texturecolumnlump;
-unsigned short**	texturecolumnofs;
+unsigned int**		texturecolumnofs;
+int**			texturewallofs;		// composite offset, or -1
 byte**			texturecomposite;
 
 // for global animation
@@ -163,6 +166,34 @@ fixed_t*	spritetopoffset;
 lighttable_t	*colormaps;
 
 
+//
+// Cache pinning.
+// While several threads render at once, none of them may purge
+//  data another one is still drawing from. Between R_PinCache and
+//  R_UnpinCache, cache lookups made while rendering are serialized,
+//  and everything they return is held PU_STATIC until the frame ends.
+//
+static pthread_mutex_t	cachemutex = PTHREAD_MUTEX_INITIALIZER;
+static boolean		cachepinned;
+static int		pingeneration;
+
+// pingeneration at which each lump or composite was pinned
+static int*		lumppinned;
+static int*		texturepinned;
+
+// everything pinned this frame, to be released afterwards
+static int*		pinnedlumps;
+static int		numpinnedlumps;
+static int*		pinnedtextures;
+static int		numpinnedtextures;
+
+// what this thread already looked up this frame
+static THREADLOCAL int*		lumpseen;
+static THREADLOCAL void**	lumpseendata;
+static THREADLOCAL int*		textureseen;
+static THREADLOCAL byte**	textureseendata;
+
+
 //
 // MAPTEXTURE_T CACHING
 // When a texture is first needed,
@@ -234,8 +265,7 @@ void R_GenerateComposite (int texnum)
     int			x2;
     int			i;
     column_t*		patchcol;
-    short*		collump;
-    unsigned short*	colofs;
+    int*		wallofs;
 	
     texture = textures[texnum];
 
@@ -243,8 +273,7 @@ void R_GenerateComposite (int texnum)
 		      PU_STATIC, 
 		      &texturecomposite[texnum]);	
 
-    collump = texturecolumnlump[texnum];
-    colofs = texturecolumnofs[texnum];
+    wallofs = texturewallofs[texnum];
     
     // Composite the columns together.
     patch = texture->patches;
@@ -267,14 +296,14 @@ void R_GenerateComposite (int texnum)
 
 	for ( ; x<x2 ; x++)
 	{
-	    // Column does not have multiple patches?
-	    if (collump[x] >= 0)
+	    // Column not drawn from the cached block?
+	    if (wallofs[x] < 0)
 		continue;
 	    
 	    patchcol = (column_t *)((byte *)realpatch
 				    + LONG(realpatch->columnofs[x-x1]));
 	    R_DrawColumnInCache (patchcol,
-				 block + colofs[x],
+				 block + wallofs[x],
 				 patch->originy,
 				 texture->height);
 	}
@@ -295,14 +324,17 @@ void R_GenerateLookup (int texnum)
 {
     texture_t*		texture;
     byte*		patchcount;	// patchcount[texture->width]
+    byte*		contiguous;	// contiguous[texture->width]
     texpatch_t*		patch;	
     patch_t*		realpatch;
+    column_t*		patchcol;
     int			x;
     int			x1;
     int			x2;
     int			i;
     short*		collump;
-    unsigned short*	colofs;
+    unsigned int*	colofs;
+    int*		wallofs;
 	
     texture = textures[texnum];
 
@@ -312,6 +344,7 @@ void R_GenerateLookup (int texnum)
     texturecompositesize[texnum] = 0;
     collump = texturecolumnlump[texnum];
     colofs = texturecolumnofs[texnum];
+    wallofs = texturewallofs[texnum];
     
     // Now count the number of columns
     //  that are covered by more than one patch.
@@ -319,6 +352,10 @@ void R_GenerateLookup (int texnum)
     //  with only a single patch are all done.
     patchcount = (byte *) Z_Malloc(texture->width, PU_STATIC, &patchcount);
     memset (patchcount, 0, texture->width);
+    contiguous = (byte *) Z_Malloc(texture->width, PU_STATIC, &contiguous);
+
+    for (x=0 ; x<texture->width ; x++)
+	wallofs[x] = -1;
     patch = texture->patches;
 
     for (i=0 , patch = texture->patches;
@@ -341,6 +378,14 @@ void R_GenerateLookup (int texnum)
 	    patchcount[x]++;
 	    collump[x] = patch->patch;
 	    colofs[x] = LONG(realpatch->columnofs[x-x1])+3;
+
+	    // Is it one post, long enough for the wall drawers?
+	    patchcol = (column_t *)((byte *)realpatch
+				    + LONG(realpatch->columnofs[x-x1]));
+	    contiguous[x] = patchcol->topdelta != 0xff
+			    && patchcol->length >= texture->height
+			    && ((column_t *)((byte *)patchcol
+					     + patchcol->length + 4))->topdelta == 0xff;
 	}
     }
 	
@@ -350,6 +395,8 @@ void R_GenerateLookup (int texnum)
 	{
 	    printf ("R_GenerateLookup: column without a patch (%s)\n",
 		    texture->name);
+	    Z_Free(patchcount);
+	    Z_Free(contiguous);
 	    return;
 	}
 	// I_Error ("R_GenerateLookup: column without a patch");
@@ -359,25 +406,181 @@ void R_GenerateLookup (int texnum)
 	    // Use the cached block.
 	    collump[x] = -1;	
 	    colofs[x] = texturecompositesize[texnum];
-	    
-	    if (texturecompositesize[texnum] > 0x10000-texture->height)
-	    {
-		I_Error ("R_GenerateLookup: texture %i is >64k",
-			 texnum);
-	    }
-	    
+	    wallofs[x] = colofs[x];
+	    texturecompositesize[texnum] += texture->height;
+	}
+	else if (!contiguous[x] || texture->height > 128)
+	{
+	    // The wall drawers read texture->height bytes
+	    //  in a row, so they use the cached block too.
+	    // Masked drawing keeps walking the patch's posts.
+	    wallofs[x] = texturecompositesize[texnum];
 	    texturecompositesize[texnum] += texture->height;
 	}
     }
 
     Z_Free(patchcount);
+    Z_Free(contiguous);
+}
+
+
+
+
+//
+// R_PinCache
+// Called before rendering on several threads.
+//
+void R_PinCache (void)
+{
+    if (!lumppinned)
+    {
+	lumppinned = calloc(numlumps, sizeof(*lumppinned));
+	pinnedlumps = malloc(numlumps * sizeof(*pinnedlumps));
+	texturepinned = calloc(numtextures, sizeof(*texturepinned));
+	pinnedtextures = malloc(numtextures * sizeof(*pinnedtextures));
+
+	if (!lumppinned || !pinnedlumps || !texturepinned || !pinnedtextures)
+	    I_Error ("R_PinCache: out of memory");
+    }
+
+    pingeneration++;
+    cachepinned = true;
+}
+
+
+//
+// R_UnpinCache
+// Called once all render threads are done, to make
+//  everything pinned during the frame purgable again.
+//
+void R_UnpinCache (void)
+{
+    int		i;
+
+    for (i=0 ; i<numpinnedlumps ; i++)
+	W_ReleaseLumpNum (pinnedlumps[i]);
+
+    for (i=0 ; i<numpinnedtextures ; i++)
+	Z_ChangeTag (texturecomposite[pinnedtextures[i]], PU_CACHE);
+
+    numpinnedlumps = 0;
+    numpinnedtextures = 0;
+    cachepinned = false;
+}
+
+
+//
+// R_CacheLumpNum
+// W_CacheLumpNum for the renderer, safe to call from
+//  several render threads while the cache is pinned.
+//
+void*
+R_CacheLumpNum
+( int		lump,
+  int		tag )
+{
+    void*	result;
+
+    if (!cachepinned)
+	return W_CacheLumpNum(lump, tag);
+
+    if (!lumpseen)
+    {
+	lumpseen = calloc(numlumps, sizeof(*lumpseen));
+	lumpseendata = calloc(numlumps, sizeof(*lumpseendata));
+
+	if (!lumpseen || !lumpseendata)
+	    I_Error ("R_CacheLumpNum: out of memory");
+    }
+
+    if (lumpseen[lump] == pingeneration)
+	return lumpseendata[lump];
+
+    pthread_mutex_lock(&cachemutex);
+
+    result = W_CacheLumpNum(lump, PU_STATIC);
+
+    if (lumppinned[lump] != pingeneration)
+    {
+	lumppinned[lump] = pingeneration;
+	pinnedlumps[numpinnedlumps++] = lump;
+    }
+
+    pthread_mutex_unlock(&cachemutex);
+
+    lumpseen[lump] = pingeneration;
+    lumpseendata[lump] = result;
+
+    return result;
 }
 
 
+//
+// R_ReleaseLumpNum
+// Lumps cached while the cache is pinned are released by R_UnpinCache.
+//
+void R_ReleaseLumpNum (int lump)
+{
+    if (!cachepinned)
+	W_ReleaseLumpNum(lump);
+}
+
+
+//
+// R_CacheComposite
+// Returns the composite of a texture, generating it if needed.
+//
+byte* R_CacheComposite (int tex)
+{
+    byte*	result;
+
+    if (!cachepinned)
+    {
+	if (!texturecomposite[tex])
+	    R_GenerateComposite (tex);
+
+	return texturecomposite[tex];
+    }
+
+    if (!textureseen)
+    {
+	textureseen = calloc(numtextures, sizeof(*textureseen));
+	textureseendata = calloc(numtextures, sizeof(*textureseendata));
+
+	if (!textureseen || !textureseendata)
+	    I_Error ("R_CacheComposite: out of memory");
+    }
+
+    if (textureseen[tex] == pingeneration)
+	return textureseendata[tex];
+
+    pthread_mutex_lock(&cachemutex);
+
+    if (!texturecomposite[tex])
+	R_GenerateComposite (tex);
+
+    if (texturepinned[tex] != pingeneration)
+    {
+	Z_ChangeTag (texturecomposite[tex], PU_STATIC);
+	texturepinned[tex] = pingeneration;
+	pinnedtextures[numpinnedtextures++] = tex;
+    }
+
+    result = texturecomposite[tex];
+
+    pthread_mutex_unlock(&cachemutex);
+
+    textureseen[tex] = pingeneration;
+    textureseendata[tex] = result;
+
+    return result;
+}
 
 
 //
 // R_GetColumn
+// Column of texture->height contiguous bytes,
+//  for the wall drawers.
 //
 byte*
 R_GetColumn
@@ -387,17 +590,40 @@ R_GetColumn
     int		lump;
     int		ofs;
 	
+    col &= texturewidthmask[tex];
+    ofs = texturewallofs[tex][col];
+
+    if (ofs >= 0)
+	return R_CacheComposite(tex) + ofs;
+
+    lump = texturecolumnlump[tex][col];
+    ofs = texturecolumnofs[tex][col];
+
+    return (byte *)R_CacheLumpNum(lump,PU_CACHE)+ofs;
+}
+
+
+//
+// R_GetMaskedColumn
+// Column as the masked drawers walk it,
+//  straight from the patch where it has one.
+//
+byte*
+R_GetMaskedColumn
+( int		tex,
+  int		col )
+{
+    int		lump;
+    int		ofs;
+	
     col &= texturewidthmask[tex];
     lump = texturecolumnlump[tex][col];
     ofs = texturecolumnofs[tex][col];
     
     if (lump > 0)
-	return (byte *)W_CacheLumpNum(lump,PU_CACHE)+ofs;
-
-    if (!texturecomposite[tex])
-	R_GenerateComposite (tex);
+	return (byte *)R_CacheLumpNum(lump,PU_CACHE)+ofs;
 
-    return texturecomposite[tex] + ofs;
+    return R_CacheComposite(tex) + ofs;
 }
 
 
@@ -522,6 +748,7 @@ void R_InitTextures (void)
     textures = Z_Malloc (numtextures * sizeof(*textures), PU_STATIC, 0);
     texturecolumnlump = Z_Malloc (numtextures * sizeof(*texturecolumnlump), PU_STATIC, 0);
     texturecolumnofs = Z_Malloc (numtextures * sizeof(*texturecolumnofs), PU_STATIC, 0);
+    texturewallofs = Z_Malloc (numtextures * sizeof(*texturewallofs), PU_STATIC, 0);
     texturecomposite = Z_Malloc (numtextures * sizeof(*texturecomposite), PU_STATIC, 0);
     texturecompositesize = Z_Malloc (numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
     texturewidthmask = Z_Malloc (numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
@@ -594,6 +821,7 @@ void R_InitTextures (void)
 	}		
 	texturecolumnlump[i] = Z_Malloc (texture->width*sizeof(**texturecolumnlump), PU_STATIC,0);
 	texturecolumnofs[i] = Z_Malloc (texture->width*sizeof(**texturecolumnofs), PU_STATIC,0);
+	texturewallofs[i] = Z_Malloc (texture->width*sizeof(**texturewallofs), PU_STATIC,0);
 
 	j = 1;
 	while (j*2 <= texture->width)
@@ -31,6 +31,21 @@ R_GetColumn
 ( int		tex,
   int		col );
 
+// Retrieve column data for masked drawing, as posts.
+byte*
+R_GetMaskedColumn
+( int		tex,
+  int		col );
+
+
+// Cache lookups for the renderer, which may run on several threads
+//  between R_PinCache and R_UnpinCache.
+void R_PinCache (void);
+void R_UnpinCache (void);
+void* R_CacheLumpNum (int lump, int tag);
+void R_ReleaseLumpNum (int lump);
+byte* R_CacheComposite (int tex);
+
 
 // I/O, setting up the stuff.
 void R_InitData (void);
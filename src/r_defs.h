@@ -48,6 +48,7 @@
 #define SIL_TOP			2
 #define SIL_BOTH		3
 
+// Initial number of drawsegs, which grow as needed.
 #define MAXDRAWSEGS		256
 
 
@@ -75,6 +76,9 @@ typedef struct
 // Forward of LineDefs, for Sectors.
 struct line_s;
 
+// Forward of touching links, for Sectors.
+struct msecnode_s;
+
 // Each sector has a degenmobj_t in its center
 //  for sound origin purposes.
 // I suppose this does not handle sound from
@@ -122,6 +126,9 @@ typedef	struct
     // list of mobjs in sector
     mobj_t*	thinglist;
 
+    // list of blockmap mobjs whose boxes overlap the sector
+    struct msecnode_s*	touchinglist;
+
     // thinker_t for reversable actions
     void*	specialdata;
 
@@ -131,6 +138,26 @@ typedef	struct
 } sector_t;
 
 
+//
+// A mobj touching a sector.
+// Each node is on the sector's touchinglist
+// and on the mobj's own list of touched sectors.
+//
+typedef struct msecnode_s
+{
+    sector_t*		sector;
+    mobj_t*		thing;
+
+    // next sector touched by the same mobj
+    struct msecnode_s*	tnext;
+
+    // links in the sector's touchinglist
+    struct msecnode_s*	snext;
+    struct msecnode_s*	sprev;
+
+} msecnode_t;
+
+
 
 
 //
@@ -420,8 +447,11 @@ typedef struct
 //
 // Now what is a visplane, anyway?
 // 
-typedef struct
+typedef struct visplane_s
 {
+  // next in its hash chain, or in the free list
+  struct visplane_s*	next;
+
   fixed_t		height;
   int			picnum;
   int			lightlevel;
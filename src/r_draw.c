@@ -25,6 +25,7 @@
 #include "deh_main.h"
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "z_zone.h"
 #include "w_wad.h"
 
@@ -36,6 +37,11 @@
 // State.
 #include "doomstat.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define R_DRAW_X86
+#include <immintrin.h>
+#endif
+
 
 // ?
 #define MAXWIDTH			1120
@@ -63,6 +69,19 @@ int		viewwindowy;
 byte*		ylookup[MAXHEIGHT]; 
 int		columnofs[MAXWIDTH]; 
 
+// With -columnmajor the view is drawn column by column into
+//  viewbuffer, and R_TransposeView copies it to the screen.
+boolean		columnmajor;
+static byte*	viewbuffer;
+
+// Copy of the last view drawn, see R_SaveView.
+static byte*	savedview;
+
+// Distance from a pixel of the view to the one below it,
+//  and to the one right of it.
+int		rowstride = SCREENWIDTH;
+int		colstride = 1;
+
 // Color tables for different players,
 //  translate a limited part to another
 //  (color ramps used for  suit colors).
@@ -74,23 +93,46 @@ byte		translations[3][256];
 
 static byte *background_buffer = NULL;
 
+// Drawers picked by R_InitDrawers
+void		(*drawcolumn) (void);
+void		(*drawcolumnlow) (void);
+void		(*drawnonpow2column) (void);
+void		(*drawnonpow2columnlow) (void);
+void		(*drawpostcolumn) (void);
+void		(*drawpostcolumnlow) (void);
+void		(*drawtranslatedcolumn) (void);
+void		(*drawspan) (void);
+void		(*drawspanlow) (void);
+
 
 //
 // R_DrawColumn
 // Source is the top of the column to scale.
 //
-lighttable_t*		dc_colormap; 
-int			dc_x; 
-int			dc_yl; 
-int			dc_yh; 
-fixed_t			dc_iscale; 
-fixed_t			dc_texturemid;
+THREADLOCAL lighttable_t*		dc_colormap; 
+THREADLOCAL int			dc_x; 
+THREADLOCAL int			dc_yl; 
+THREADLOCAL int			dc_yh; 
+THREADLOCAL fixed_t			dc_iscale; 
+THREADLOCAL fixed_t			dc_texturemid;
+THREADLOCAL int			dc_texheight;
 
 // first pixel in a column (possibly virtual) 
-byte*			dc_source;		
+THREADLOCAL byte*			dc_source;		
 
 // just for profiling 
-int			dccount;
+THREADLOCAL int			dccount;
+
+// Columns drawn by this render thread
+THREADLOCAL int			stripx1 = 0;
+THREADLOCAL int			stripx2 = SCREENWIDTH-1;
+
+//
+// How the texture coordinate of a column wraps around.
+//
+#define WRAP_POW2	0	// mask with dc_texheight-1
+#define WRAP_ANY	1	// any dc_texheight, wrapped by subtraction
+#define WRAP_POST	2	// posts of masked columns, mask with 127
 
 //
 // A column is a vertical slice/span from a wall texture that,
@@ -98,22 +140,37 @@ int			dccount;
 //  will always have constant z depth.
 // Thus a special case loop for very fast rendering can
 //  be used. It has also been used with Wolfenstein 3D.
+// Always inlined with a constant wrap and detail, so each drawer
+//  below gets its own loop without any of the branches.
 // 
-void R_DrawColumn (void) 
+// Distance to the pixel below and right of another, in the
+//  row-major screen or the column-major view buffer.
+#define PIXELDOWN(cm)		((cm) ? 1 : SCREENWIDTH)
+#define PIXELRIGHT(cm)		((cm) ? SCREENHEIGHT : 1)
+
+__attribute__((always_inline))
+static inline void R_DrawColumnWrap (int wrap, boolean low, boolean cm)
 { 
     int			count; 
     byte*		dest; 
     fixed_t		frac;
     fixed_t		fracstep;	 
+    fixed_t		height;
+    int			mask;
+    int                 x;
+    byte		pixel;
  
     count = dc_yh - dc_yl; 
 
     // Zero length, column does not exceed a pixel.
     if (count < 0) 
 	return; 
+
+    // Blocky mode, need to multiply by 2.
+    x = low ? dc_x << 1 : dc_x;
 				 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
+    if ((unsigned)x >= SCREENWIDTH
 	|| dc_yl < 0
 	|| dc_yh >= SCREENHEIGHT) 
 	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
@@ -122,13 +179,31 @@ void R_DrawColumn (void)
     // Framebuffer destination address.
     // Use ylookup LUT to avoid multiply with ScreenWidth.
     // Use columnofs LUT for subwindows? 
-    dest = ylookup[dc_yl] + columnofs[dc_x];  
+    dest = ylookup[dc_yl] + columnofs[x];  
 
     // Determine scaling,
     //  which is the only mapping to be done.
     fracstep = dc_iscale; 
     frac = dc_texturemid + (dc_yl-centery)*fracstep; 
 
+    height = 0;
+    mask = 127;
+
+    if (wrap == WRAP_ANY)
+    {
+	// Start inside the texture, so each step
+	//  wraps with at most one subtraction.
+	height = dc_texheight << FRACBITS;
+	frac %= height;
+	if (frac < 0)
+	    frac += height;
+	fracstep %= height;
+    }
+    else if (wrap == WRAP_POW2)
+    {
+	mask = dc_texheight - 1;
+    }
+
     // Inner loop that does the actual texture mapping,
     //  e.g. a DDA-lile scaling.
     // This is as fast as it gets.
@@ -136,14 +211,44 @@ void R_DrawColumn (void)
     {
 	// Re-map color indices from wall texture column
 	//  using a lighting/special effects LUT.
-	*dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
+	if (wrap == WRAP_ANY)
+	    pixel = dc_colormap[dc_source[frac>>FRACBITS]];
+	else
+	    pixel = dc_colormap[dc_source[(frac>>FRACBITS)&mask]];
+
+	*dest = pixel;
+	if (low)
+	    dest[PIXELRIGHT(cm)] = pixel;
 	
-	dest += SCREENWIDTH; 
+	dest += PIXELDOWN(cm); 
 	frac += fracstep;
+
+	if (wrap == WRAP_ANY && frac >= height)
+	    frac -= height;
 	
     } while (count--); 
 } 
 
+#define COLUMN_DRAWER(name, wrap, low, cm) \
+    void name (void) \
+    { \
+	R_DrawColumnWrap (wrap, low, cm); \
+    }
+
+COLUMN_DRAWER(R_DrawColumn, WRAP_POW2, false, false)
+COLUMN_DRAWER(R_DrawColumnLow, WRAP_POW2, true, false)
+COLUMN_DRAWER(R_DrawColumnNonPow2, WRAP_ANY, false, false)
+COLUMN_DRAWER(R_DrawColumnNonPow2Low, WRAP_ANY, true, false)
+COLUMN_DRAWER(R_DrawPostColumn, WRAP_POST, false, false)
+COLUMN_DRAWER(R_DrawPostColumnLow, WRAP_POST, true, false)
+
+COLUMN_DRAWER(R_DrawColumnCM, WRAP_POW2, false, true)
+COLUMN_DRAWER(R_DrawColumnLowCM, WRAP_POW2, true, true)
+COLUMN_DRAWER(R_DrawColumnNonPow2CM, WRAP_ANY, false, true)
+COLUMN_DRAWER(R_DrawColumnNonPow2LowCM, WRAP_ANY, true, true)
+COLUMN_DRAWER(R_DrawPostColumnCM, WRAP_POST, false, true)
+COLUMN_DRAWER(R_DrawPostColumnLowCM, WRAP_POST, true, true)
+
 
 
 // UNUSED.
@@ -205,57 +310,13 @@ void R_DrawColumn (void)
 #endif
 
 
-void R_DrawColumnLow (void) 
-{ 
-    int			count; 
-    byte*		dest; 
-    byte*		dest2;
-    fixed_t		frac;
-    fixed_t		fracstep;	 
-    int                 x;
- 
-    count = dc_yh - dc_yl; 
-
-    // Zero length.
-    if (count < 0) 
-	return; 
-				 
-#ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT)
-    {
-	
-	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
-    }
-    //	dccount++; 
-#endif 
-    // Blocky mode, need to multiply by 2.
-    x = dc_x << 1;
-    
-    dest = ylookup[dc_yl] + columnofs[x];
-    dest2 = ylookup[dc_yl] + columnofs[x+1];
-    
-    fracstep = dc_iscale; 
-    frac = dc_texturemid + (dc_yl-centery)*fracstep;
-    
-    do 
-    {
-	// Hack. Does not work corretly.
-	*dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
-	frac += fracstep; 
-
-    } while (count--);
-}
-
 
 //
 // Spectre/Invisibility.
 //
 #define FUZZTABLE		50 
-#define FUZZOFF	(SCREENWIDTH)
+// One row up or down. R_InitBuffer scales these to rowstride.
+#define FUZZOFF	1
 
 
 int	fuzzoffset[FUZZTABLE] =
@@ -269,7 +330,7 @@ int	fuzzoffset[FUZZTABLE] =
     FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF 
 }; 
 
-int	fuzzpos = 0; 
+THREADLOCAL int	fuzzpos = 0; 
 
 
 //
@@ -301,6 +362,14 @@ void R_DrawFuzzColumn (void)
     if (count < 0) 
 	return; 
 
+    // Outside this thread's strip, only step the pattern on,
+    //  so it lines up with the columns that are drawn.
+    if (dc_x < stripx1 || dc_x > stripx2)
+    {
+	fuzzpos = (fuzzpos + count + 1) % FUZZTABLE;
+	return;
+    }
+
 #ifdef RANGECHECK 
     if ((unsigned)dc_x >= SCREENWIDTH
 	|| dc_yl < 0 || dc_yh >= SCREENHEIGHT)
@@ -331,7 +400,7 @@ void R_DrawFuzzColumn (void)
 	if (++fuzzpos == FUZZTABLE) 
 	    fuzzpos = 0;
 	
-	dest += SCREENWIDTH;
+	dest += rowstride;
 
 	frac += fracstep; 
     } while (count--); 
@@ -362,6 +431,14 @@ void R_DrawFuzzColumnLow (void)
     if (count < 0) 
 	return; 
 
+    // Outside this thread's strip, only step the pattern on,
+    //  so it lines up with the columns that are drawn.
+    if (dc_x < stripx1 || dc_x > stripx2)
+    {
+	fuzzpos = (fuzzpos + count + 1) % FUZZTABLE;
+	return;
+    }
+
     // low detail mode, need to multiply by 2
     
     x = dc_x << 1;
@@ -398,8 +475,8 @@ void R_DrawFuzzColumnLow (void)
 	if (++fuzzpos == FUZZTABLE) 
 	    fuzzpos = 0;
 	
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
+	dest += rowstride;
+	dest2 += rowstride;
 
 	frac += fracstep; 
     } while (count--); 
@@ -418,7 +495,7 @@ void R_DrawFuzzColumnLow (void)
 //  of the BaronOfHell, the HellKnight, uses
 //  identical sprites, kinda brightened up.
 //
-byte*	dc_translation;
+THREADLOCAL byte*	dc_translation;
 byte*	translationtables;
 
 void R_DrawTranslatedColumn (void) 
@@ -459,7 +536,7 @@ void R_DrawTranslatedColumn (void)
 	// Thus the "green" ramp of the player 0 sprite
 	//  is mapped to gray, red, black/indigo. 
 	*dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-	dest += SCREENWIDTH;
+	dest += rowstride;
 	
 	frac += fracstep; 
     } while (count--); 
@@ -510,8 +587,8 @@ void R_DrawTranslatedColumnLow (void)
 	//  is mapped to gray, red, black/indigo. 
 	*dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
 	*dest2 = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
+	dest += rowstride;
+	dest2 += rowstride;
 	
 	frac += fracstep; 
     } while (count--); 
@@ -567,22 +644,22 @@ void R_InitTranslationTables (void)
 // In consequence, flats are not stored by column (like walls),
 //  and the inner loop has to step in texture space u and v.
 //
-int			ds_y; 
-int			ds_x1; 
-int			ds_x2;
+THREADLOCAL int			ds_y; 
+THREADLOCAL int			ds_x1; 
+THREADLOCAL int			ds_x2;
 
-lighttable_t*		ds_colormap; 
+THREADLOCAL lighttable_t*		ds_colormap; 
 
-fixed_t			ds_xfrac; 
-fixed_t			ds_yfrac; 
-fixed_t			ds_xstep; 
-fixed_t			ds_ystep;
+THREADLOCAL fixed_t			ds_xfrac; 
+THREADLOCAL fixed_t			ds_yfrac; 
+THREADLOCAL fixed_t			ds_xstep; 
+THREADLOCAL fixed_t			ds_ystep;
 
 // start of a 64*64 tile image 
-byte*			ds_source;	
+THREADLOCAL byte*			ds_source;	
 
 // just for profiling
-int			dscount;
+THREADLOCAL int			dscount;
 
 
 //
@@ -631,7 +708,8 @@ void R_DrawSpan (void)
 
 	// Lookup pixel from flat texture tile,
 	//  re-index using light/colormap.
-	*dest++ = ds_colormap[ds_source[spot]];
+	*dest = ds_colormap[ds_source[spot]];
+	dest += colstride;
 
         position += step;
 
@@ -713,6 +791,30 @@ void R_DrawSpan (void)
 #endif
 
 
+//
+// R_SkipSpan
+// Moves the start of the span count pixels to the right, with
+//  ds_xfrac and ds_yfrac where the span drawers would have stepped
+//  them to. Used to start a span at the edge of a strip.
+//
+void R_SkipSpan (int count)
+{
+    unsigned int position, step;
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    position += step * count;
+
+    // Unpack to fractions that pack back to the same position
+    ds_xfrac = (position >> 16) << 6;
+    ds_yfrac = (position & 0x0000ffff) << 6;
+    ds_x1 += count;
+}
+
+
 //
 // Again..
 //
@@ -758,14 +860,479 @@ void R_DrawSpanLow (void)
 
 	// Lowres/blocky mode does it twice,
 	//  while scale is adjusted appropriately.
-	*dest++ = ds_colormap[ds_source[spot]];
-	*dest++ = ds_colormap[ds_source[spot]];
+	dest[0] = dest[colstride] = ds_colormap[ds_source[spot]];
+	dest += colstride*2;
 
 	position += step;
 
     } while (count--);
 }
 
+
+//
+// SIMD DRAWERS
+// Variants of the drawers above that compute several pixels at once.
+// Texture and colormap bytes are fetched with 32-bit gathers from
+//  three bytes before the wanted one, keeping the wanted byte in the
+//  top of each lane. The three bytes read before a column, flat or
+//  colormap always lie inside the lump or its zone block header,
+//  while reading past the end of them could leave the zone.
+// The output is identical to that of the plain drawers.
+//
+#ifdef R_DRAW_X86
+
+// Texture coordinates of 8 pixels, 1 step apart
+#define STEP_LANES(start, step) \
+    _mm256_add_epi32(_mm256_set1_epi32(start), \
+		     _mm256_mullo_epi32(_mm256_set1_epi32(step), \
+					_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)))
+
+__attribute__((target("avx2")))
+static inline __m256i R_GatherBytesAVX2 (const byte* base, __m256i index)
+{
+    return _mm256_srli_epi32(_mm256_i32gather_epi32((const int *) (base - 3),
+						    index, 1), 24);
+}
+
+// Packs the low byte of each lane into the low 8 bytes
+__attribute__((target("avx2")))
+static inline __m128i R_PackBytesAVX2 (__m256i pixels)
+{
+    pixels = _mm256_packus_epi32(pixels, pixels);
+    pixels = _mm256_packus_epi16(pixels, pixels);
+
+    return _mm_unpacklo_epi32(_mm256_castsi256_si128(pixels),
+			      _mm256_extracti128_si256(pixels, 1));
+}
+
+// Vector version of R_DrawColumnWrap for the masked wraps
+__attribute__((target("avx2"), always_inline))
+static inline void R_DrawColumnWrapAVX2 (int wrap, boolean low, boolean cm) 
+{ 
+    int			count; 
+    byte*		dest; 
+    fixed_t		frac;
+    fixed_t		fracstep;	 
+    int			mask;
+    int                 x;
+    __m256i		fracs;
+    __m256i		fracsstep;
+    __m256i		pixels;
+    byte		column[8];
+    int			i;
+ 
+    count = dc_yh - dc_yl + 1; 
+
+    if (count <= 0) 
+	return; 
+
+    x = low ? dc_x << 1 : dc_x;
+				 
+#ifdef RANGECHECK 
+    if ((unsigned)x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT) 
+	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
+#endif 
+
+    dest = ylookup[dc_yl] + columnofs[x];  
+    fracstep = dc_iscale; 
+    frac = dc_texturemid + (dc_yl-centery)*fracstep; 
+    mask = wrap == WRAP_POW2 ? dc_texheight - 1 : 127;
+
+    fracs = STEP_LANES(frac, fracstep);
+    fracsstep = _mm256_set1_epi32(fracstep * 8);
+
+    while (count >= 8)
+    {
+	pixels = _mm256_and_si256(_mm256_srli_epi32(fracs, FRACBITS),
+				  _mm256_set1_epi32(mask));
+	pixels = R_GatherBytesAVX2(dc_source, pixels);
+	pixels = R_GatherBytesAVX2(dc_colormap, pixels);
+
+	if (cm)
+	{
+	    // Column-major, so the pixels are contiguous
+	    _mm_storel_epi64((__m128i *) dest, R_PackBytesAVX2(pixels));
+	    if (low)
+		_mm_storel_epi64((__m128i *) (dest + SCREENHEIGHT),
+				 R_PackBytesAVX2(pixels));
+	}
+	else
+	{
+	    _mm_storel_epi64((__m128i *) column, R_PackBytesAVX2(pixels));
+
+	    // Columns are vertical, so the pixels land one row apart
+	    for (i=0 ; i<8 ; i++)
+	    {
+		dest[i*SCREENWIDTH] = column[i];
+		if (low)
+		    dest[i*SCREENWIDTH+1] = column[i];
+	    }
+	}
+
+	dest += PIXELDOWN(cm)*8;
+	fracs = _mm256_add_epi32(fracs, fracsstep);
+	frac += fracstep * 8;
+	count -= 8;
+    }
+
+    while (count--)
+    {
+	dest[0] = dc_colormap[dc_source[(frac>>FRACBITS)&mask]];
+	if (low)
+	    dest[PIXELRIGHT(cm)] = dest[0];
+	dest += PIXELDOWN(cm); 
+	frac += fracstep;
+    }
+} 
+
+#define COLUMN_DRAWER_AVX2(name, wrap, low, cm) \
+    __attribute__((target("avx2"))) \
+    static void name (void) \
+    { \
+	R_DrawColumnWrapAVX2 (wrap, low, cm); \
+    }
+
+COLUMN_DRAWER_AVX2(R_DrawColumnAVX2, WRAP_POW2, false, false)
+COLUMN_DRAWER_AVX2(R_DrawColumnLowAVX2, WRAP_POW2, true, false)
+COLUMN_DRAWER_AVX2(R_DrawPostColumnAVX2, WRAP_POST, false, false)
+COLUMN_DRAWER_AVX2(R_DrawPostColumnLowAVX2, WRAP_POST, true, false)
+
+COLUMN_DRAWER_AVX2(R_DrawColumnCMAVX2, WRAP_POW2, false, true)
+COLUMN_DRAWER_AVX2(R_DrawColumnLowCMAVX2, WRAP_POW2, true, true)
+COLUMN_DRAWER_AVX2(R_DrawPostColumnCMAVX2, WRAP_POST, false, true)
+COLUMN_DRAWER_AVX2(R_DrawPostColumnLowCMAVX2, WRAP_POST, true, true)
+
+__attribute__((target("avx2")))
+static void R_DrawTranslatedColumnAVX2 (void) 
+{ 
+    int			count; 
+    byte*		dest; 
+    fixed_t		frac;
+    fixed_t		fracstep;	 
+    __m256i		fracs;
+    __m256i		fracsstep;
+    __m256i		pixels;
+    byte		column[8];
+    int			i;
+ 
+    count = dc_yh - dc_yl + 1; 
+
+    if (count <= 0) 
+	return; 
+				 
+#ifdef RANGECHECK 
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+    {
+	I_Error ( "R_DrawColumn: %i to %i at %i",
+		  dc_yl, dc_yh, dc_x);
+    }
+#endif 
+
+    dest = ylookup[dc_yl] + columnofs[dc_x]; 
+    fracstep = dc_iscale; 
+    frac = dc_texturemid + (dc_yl-centery)*fracstep; 
+
+    fracs = STEP_LANES(frac, fracstep);
+    fracsstep = _mm256_set1_epi32(fracstep * 8);
+
+    while (count >= 8)
+    {
+	// Sprite columns are not wrapped, so keep the sign of frac
+	pixels = _mm256_srai_epi32(fracs, FRACBITS);
+	pixels = R_GatherBytesAVX2(dc_source, pixels);
+	pixels = R_GatherBytesAVX2(dc_translation, pixels);
+	pixels = R_GatherBytesAVX2(dc_colormap, pixels);
+	_mm_storel_epi64((__m128i *) column, R_PackBytesAVX2(pixels));
+
+	for (i=0 ; i<8 ; i++)
+	    dest[i*rowstride] = column[i];
+
+	dest += rowstride*8;
+	fracs = _mm256_add_epi32(fracs, fracsstep);
+	frac += fracstep * 8;
+	count -= 8;
+    }
+
+    while (count--)
+    {
+	*dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
+	dest += rowstride;
+	frac += fracstep; 
+    }
+} 
+
+// Flat texture indices of 8 pixels, from packed positions
+__attribute__((target("avx2")))
+static inline __m256i R_SpanSpotsAVX2 (__m256i positions)
+{
+    return _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(positions, 4),
+					    _mm256_set1_epi32(0x0fc0)),
+			   _mm256_srli_epi32(positions, 26));
+}
+
+__attribute__((target("avx2")))
+static void R_DrawSpanAVX2 (void) 
+{ 
+    unsigned int position, step;
+    byte *dest;
+    int count;
+    int spot;
+    __m256i positions;
+    __m256i positionsstep;
+    __m256i pixels;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    positions = STEP_LANES(position, step);
+    positionsstep = _mm256_set1_epi32(step * 8);
+
+    while (count >= 8)
+    {
+	pixels = R_GatherBytesAVX2(ds_source, R_SpanSpotsAVX2(positions));
+	pixels = R_GatherBytesAVX2(ds_colormap, pixels);
+	_mm_storel_epi64((__m128i *) dest, R_PackBytesAVX2(pixels));
+
+	dest += 8;
+	positions = _mm256_add_epi32(positions, positionsstep);
+	position += step * 8;
+	count -= 8;
+    }
+
+    while (count--)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+	*dest++ = ds_colormap[ds_source[spot]];
+        position += step;
+    }
+}
+
+__attribute__((target("avx2")))
+static void R_DrawSpanLowAVX2 (void)
+{
+    unsigned int position, step;
+    byte *dest;
+    int count;
+    int spot;
+    __m256i positions;
+    __m256i positionsstep;
+    __m256i pixels;
+    __m128i packed;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    count = ds_x2 - ds_x1 + 1;
+
+    // Blocky mode, need to multiply by 2.
+    ds_x1 <<= 1;
+    ds_x2 <<= 1;
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+
+    positions = STEP_LANES(position, step);
+    positionsstep = _mm256_set1_epi32(step * 8);
+
+    while (count >= 8)
+    {
+	pixels = R_GatherBytesAVX2(ds_source, R_SpanSpotsAVX2(positions));
+	pixels = R_GatherBytesAVX2(ds_colormap, pixels);
+	packed = R_PackBytesAVX2(pixels);
+	_mm_storeu_si128((__m128i *) dest, _mm_unpacklo_epi8(packed, packed));
+
+	dest += 16;
+	positions = _mm256_add_epi32(positions, positionsstep);
+	position += step * 8;
+	count -= 8;
+    }
+
+    while (count--)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+	*dest++ = ds_colormap[ds_source[spot]];
+	*dest++ = ds_colormap[ds_source[spot]];
+        position += step;
+    }
+}
+
+// SSE2 has no gathers, so only the texture indices of a span
+//  are computed together and the pixels looked up one by one.
+__attribute__((target("sse2")))
+static void R_DrawSpanSSE2 (void) 
+{ 
+    unsigned int position, step;
+    byte *dest;
+    int count;
+    int spot;
+    __m128i positions;
+    __m128i positionsstep;
+    int spots[4];
+    int i;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    positions = _mm_setr_epi32(position, position + step,
+			       position + step * 2, position + step * 3);
+    positionsstep = _mm_set1_epi32(step * 4);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spots,
+			 _mm_or_si128(_mm_and_si128(_mm_srli_epi32(positions, 4),
+						    _mm_set1_epi32(0x0fc0)),
+				      _mm_srli_epi32(positions, 26)));
+
+	for (i=0 ; i<4 ; i++)
+	    dest[i] = ds_colormap[ds_source[spots[i]]];
+
+	dest += 4;
+	positions = _mm_add_epi32(positions, positionsstep);
+	position += step * 4;
+	count -= 4;
+    }
+
+    while (count--)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+	*dest++ = ds_colormap[ds_source[spot]];
+        position += step;
+    }
+}
+
+#endif
+
+
+//
+// R_InitDrawers
+// Picks the view buffer layout,
+//  and the fastest drawers this CPU supports for it.
+//
+void R_InitDrawers (void)
+{
+    //!
+    // @category video
+    //
+    // Draw the view into a column-major buffer, so the pixels
+    // of each column are contiguous, and copy it to the screen
+    // once per frame.
+    //
+
+    columnmajor = M_CheckParm("-columnmajor") > 0;
+
+    if (columnmajor)
+    {
+	viewbuffer = Z_Malloc (SCREENWIDTH*SCREENHEIGHT, PU_STATIC, 0);
+
+	drawcolumn = R_DrawColumnCM;
+	drawcolumnlow = R_DrawColumnLowCM;
+	drawnonpow2column = R_DrawColumnNonPow2CM;
+	drawnonpow2columnlow = R_DrawColumnNonPow2LowCM;
+	drawpostcolumn = R_DrawPostColumnCM;
+	drawpostcolumnlow = R_DrawPostColumnLowCM;
+    }
+    else
+    {
+	drawcolumn = R_DrawColumn;
+	drawcolumnlow = R_DrawColumnLow;
+	drawnonpow2column = R_DrawColumnNonPow2;
+	drawnonpow2columnlow = R_DrawColumnNonPow2Low;
+	drawpostcolumn = R_DrawPostColumn;
+	drawpostcolumnlow = R_DrawPostColumnLow;
+    }
+
+    drawtranslatedcolumn = R_DrawTranslatedColumn;
+    drawspan = R_DrawSpan;
+    drawspanlow = R_DrawSpanLow;
+
+    //!
+    // @category video
+    //
+    // Use only the plain C column and span drawers.
+    //
+
+    if (M_CheckParm("-nosimd") > 0)
+	return;
+
+#ifdef R_DRAW_X86
+    __builtin_cpu_init();
+
+    // The vector span drawers only write rows of pixels
+    if (__builtin_cpu_supports("avx2") && columnmajor)
+    {
+	drawcolumn = R_DrawColumnCMAVX2;
+	drawcolumnlow = R_DrawColumnLowCMAVX2;
+	drawpostcolumn = R_DrawPostColumnCMAVX2;
+	drawpostcolumnlow = R_DrawPostColumnLowCMAVX2;
+	drawtranslatedcolumn = R_DrawTranslatedColumnAVX2;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+	drawcolumn = R_DrawColumnAVX2;
+	drawcolumnlow = R_DrawColumnLowAVX2;
+	drawpostcolumn = R_DrawPostColumnAVX2;
+	drawpostcolumnlow = R_DrawPostColumnLowAVX2;
+	drawtranslatedcolumn = R_DrawTranslatedColumnAVX2;
+	drawspan = R_DrawSpanAVX2;
+	drawspanlow = R_DrawSpanLowAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2") && !columnmajor)
+    {
+	drawspan = R_DrawSpanSSE2;
+    }
+#endif
+}
+
+
 //
 // R_InitBuffer 
 // Creats lookup tables that avoid
@@ -785,20 +1352,130 @@ R_InitBuffer
     //  with border and/or status bar.
     viewwindowx = (SCREENWIDTH-width) >> 1; 
 
-    // Column offset. For windows.
-    for (i=0 ; i<width ; i++) 
-	columnofs[i] = viewwindowx + i;
-
     // Samw with base row offset.
     if (width == SCREENWIDTH) 
 	viewwindowy = 0; 
     else 
 	viewwindowy = (SCREENHEIGHT-SBARHEIGHT-height) >> 1; 
 
-    // Preclaculate all row offsets.
-    for (i=0 ; i<height ; i++) 
-	ylookup[i] = I_VideoBuffer + (i+viewwindowy)*SCREENWIDTH; 
+    if (columnmajor)
+    {
+	// The view starts at the top left of viewbuffer,
+	//  with each column SCREENHEIGHT long.
+	for (i=0 ; i<width ; i++) 
+	    columnofs[i] = i*SCREENHEIGHT;
+
+	for (i=0 ; i<height ; i++) 
+	    ylookup[i] = viewbuffer + i; 
+
+	rowstride = 1;
+	colstride = SCREENHEIGHT;
+    }
+    else
+    {
+	// Column offset. For windows.
+	for (i=0 ; i<width ; i++) 
+	    columnofs[i] = viewwindowx + i;
+
+	// Preclaculate all row offsets.
+	for (i=0 ; i<height ; i++) 
+	    ylookup[i] = I_VideoBuffer + (i+viewwindowy)*SCREENWIDTH; 
+
+	rowstride = SCREENWIDTH;
+	colstride = 1;
+    }
+
+    // The shadow drawers look one row up or down
+    for (i=0 ; i<FUZZTABLE ; i++)
+	fuzzoffset[i] = fuzzoffset[i] > 0 ? rowstride : -rowstride;
 } 
+
+
+//
+// R_TransposeView
+// Copies the column-major view buffer to the screen,
+//  in blocks that stay in the cache on both sides.
+//
+#define TRANSPOSEBLOCK		16
+
+void R_TransposeView (void)
+{
+    int		x;
+    int		y;
+    int		bx;
+    int		by;
+    int		x2;
+    int		y2;
+    byte*	src;
+    byte*	dest;
+
+    for (by=0 ; by<viewheight ; by+=TRANSPOSEBLOCK)
+    {
+	y2 = by+TRANSPOSEBLOCK < viewheight ? by+TRANSPOSEBLOCK : viewheight;
+
+	for (bx=0 ; bx<scaledviewwidth ; bx+=TRANSPOSEBLOCK)
+	{
+	    x2 = bx+TRANSPOSEBLOCK < scaledviewwidth
+	       ? bx+TRANSPOSEBLOCK : scaledviewwidth;
+
+	    for (y=by ; y<y2 ; y++)
+	    {
+		src = viewbuffer + bx*SCREENHEIGHT + y;
+		dest = I_VideoBuffer + (y+viewwindowy)*SCREENWIDTH
+		     + viewwindowx + bx;
+
+		for (x=bx ; x<x2 ; x++, src += SCREENHEIGHT)
+		    *dest++ = *src;
+	    }
+	}
+    }
+}
+
+
+//
+// R_SaveView
+// Keeps a copy of the view just drawn, for R_RestoreView.
+// The column-major buffer already is one.
+//
+void R_SaveView (void)
+{
+    int		y;
+    byte*	src;
+
+    if (columnmajor)
+	return;
+
+    if (!savedview)
+	savedview = Z_Malloc (SCREENWIDTH*SCREENHEIGHT, PU_STATIC, 0);
+
+    src = I_VideoBuffer + viewwindowy*SCREENWIDTH + viewwindowx;
+
+    for (y=0 ; y<viewheight ; y++, src += SCREENWIDTH)
+	memcpy (savedview + y*scaledviewwidth, src, scaledviewwidth);
+}
+
+
+//
+// R_RestoreView
+// Puts the view saved by R_SaveView back on the screen,
+//  over whatever was drawn on it since.
+//
+void R_RestoreView (void)
+{
+    int		y;
+    byte*	dest;
+
+    if (columnmajor)
+    {
+	R_TransposeView ();
+	return;
+    }
+
+    dest = I_VideoBuffer + viewwindowy*SCREENWIDTH + viewwindowx;
+
+    for (y=0 ; y<viewheight ; y++, dest += SCREENWIDTH)
+	memcpy (dest, savedview + y*scaledviewwidth, scaledviewwidth);
+}
  
  
 
@@ -929,6 +1606,12 @@ R_VideoErase
     if (background_buffer != NULL)
     {
         memcpy(I_VideoBuffer + ofs, background_buffer + ofs, count); 
+
+	if (ofs%SCREENWIDTH + count <= SCREENWIDTH)
+	    V_MarkRect (ofs%SCREENWIDTH, ofs/SCREENWIDTH, count, 1);
+	else
+	    V_MarkRect (0, ofs/SCREENWIDTH, SCREENWIDTH,
+			(ofs%SCREENWIDTH + count + SCREENWIDTH-1)/SCREENWIDTH);
     }
 } 
 
@@ -23,22 +23,48 @@
 
 
 
-extern lighttable_t*	dc_colormap;
-extern int		dc_x;
-extern int		dc_yl;
-extern int		dc_yh;
-extern fixed_t		dc_iscale;
-extern fixed_t		dc_texturemid;
+extern THREADLOCAL lighttable_t*	dc_colormap;
+extern THREADLOCAL int		dc_x;
+extern THREADLOCAL int		dc_yl;
+extern THREADLOCAL int		dc_yh;
+extern THREADLOCAL fixed_t		dc_iscale;
+extern THREADLOCAL fixed_t		dc_texturemid;
+
+// Height the column wraps at, for the wall drawers
+extern THREADLOCAL int		dc_texheight;
 
 // first pixel in a column
-extern byte*		dc_source;		
+extern THREADLOCAL byte*		dc_source;		
+
+// Columns drawn by this render thread. The rest of the view is
+//  still clipped as usual, but not drawn.
+extern THREADLOCAL int		stripx1;
+extern THREADLOCAL int		stripx2;
+
+// Position in the fuzz pattern of the shadow drawers
+extern THREADLOCAL int		fuzzpos;
 
 
 // The span blitting interface.
 // Hook in assembler or system specific BLT
 //  here.
+// R_DrawColumn wraps at a power of two dc_texheight,
+//  R_DrawColumnNonPow2 at any other one.
+// Posts of masked columns are drawn by R_DrawPostColumn.
 void 	R_DrawColumn (void);
 void 	R_DrawColumnLow (void);
+void 	R_DrawColumnNonPow2 (void);
+void 	R_DrawColumnNonPow2Low (void);
+void 	R_DrawPostColumn (void);
+void 	R_DrawPostColumnLow (void);
+
+// The same, for the column-major view buffer.
+void 	R_DrawColumnCM (void);
+void 	R_DrawColumnLowCM (void);
+void 	R_DrawColumnNonPow2CM (void);
+void 	R_DrawColumnNonPow2LowCM (void);
+void 	R_DrawPostColumnCM (void);
+void 	R_DrawPostColumnLowCM (void);
 
 // The Spectre/Invisibility effect.
 void 	R_DrawFuzzColumn (void);
@@ -55,22 +81,22 @@ R_VideoErase
 ( unsigned	ofs,
   int		count );
 
-extern int		ds_y;
-extern int		ds_x1;
-extern int		ds_x2;
+extern THREADLOCAL int		ds_y;
+extern THREADLOCAL int		ds_x1;
+extern THREADLOCAL int		ds_x2;
 
-extern lighttable_t*	ds_colormap;
+extern THREADLOCAL lighttable_t*	ds_colormap;
 
-extern fixed_t		ds_xfrac;
-extern fixed_t		ds_yfrac;
-extern fixed_t		ds_xstep;
-extern fixed_t		ds_ystep;
+extern THREADLOCAL fixed_t		ds_xfrac;
+extern THREADLOCAL fixed_t		ds_yfrac;
+extern THREADLOCAL fixed_t		ds_xstep;
+extern THREADLOCAL fixed_t		ds_ystep;
 
 // start of a 64*64 tile image
-extern byte*		ds_source;		
+extern THREADLOCAL byte*		ds_source;		
 
 extern byte*		translationtables;
-extern byte*		dc_translation;
+extern THREADLOCAL byte*		dc_translation;
 
 
 // Span blitting for rows, floor/ceiling.
@@ -80,12 +106,45 @@ void 	R_DrawSpan (void);
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
 
+// Starts the span count pixels further right.
+void	R_SkipSpan (int count);
+
+// The drawers above, or faster ones with the same output
+//  if the CPU supports them.
+extern void		(*drawcolumn) (void);
+extern void		(*drawcolumnlow) (void);
+extern void		(*drawnonpow2column) (void);
+extern void		(*drawnonpow2columnlow) (void);
+extern void		(*drawpostcolumn) (void);
+extern void		(*drawpostcolumnlow) (void);
+extern void		(*drawtranslatedcolumn) (void);
+extern void		(*drawspan) (void);
+extern void		(*drawspanlow) (void);
+
+void	R_InitDrawers (void);
+
 
 void
 R_InitBuffer
 ( int		width,
   int		height );
 
+// The view is drawn into a column-major buffer,
+//  and R_TransposeView copies it to the screen.
+extern boolean		columnmajor;
+
+// Distance from a pixel of the view to the one below it,
+//  and to the one right of it.
+extern int		rowstride;
+extern int		colstride;
+
+void	R_TransposeView (void);
+
+// Keep the view just drawn, and put it back on the screen
+//  in place of drawing it again.
+void	R_SaveView (void);
+void	R_RestoreView (void);
+
 
 // Initialize color translation tables,
 //  for player rendering etc.
@@ -23,18 +23,27 @@
 
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
+#include <pthread.h>
+#include <signal.h>
 
 
 #include "doomdef.h"
 #include "d_loop.h"
 
+#include "i_system.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_menu.h"
 
+#include "doomstat.h"
+
 #include "r_local.h"
 #include "r_sky.h"
 
+#include "v_video.h"
+
 
 
 
@@ -51,7 +60,7 @@ int			validcount = 1;
 
 
 lighttable_t*		fixedcolormap;
-extern lighttable_t**	walllights;
+extern THREADLOCAL lighttable_t**	walllights;
 
 int			centerx;
 int			centery;
@@ -63,9 +72,45 @@ fixed_t			projection;
 // just for profiling purposes
 int			framecount;	
 
-int			sscount;
-int			linecount;
-int			loopcount;
+THREADLOCAL int			sscount;
+
+
+//
+// Parallel rendering.
+// Every render thread renders the whole view, with its own clipping
+//  state, but only draws the columns of its own strip. Each column
+//  thus comes out exactly as a single thread would have drawn it.
+//
+#define MAXRENDERTHREADS	16
+
+int			numrenderthreads = 1;
+
+static pthread_t	renderthreads[MAXRENDERTHREADS];
+static pthread_mutex_t	rendermutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	renderstart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	renderdone = PTHREAD_COND_INITIALIZER;
+static int		rendergeneration;
+static int		renderpending;
+
+// fuzzpos at the start of the frame
+static int		renderfuzzpos;
+
+//
+// View reuse.
+// With -reuseview, the sectors and sides the walk reaches are
+//  listed, and everything the view drawn from them depends on is
+//  hashed into a signature. While the signature stays the same,
+//  the saved view is put back on the screen instead of drawn.
+//
+boolean			reuseview;
+int			numviews;
+int			reusedviews;
+
+static uint64_t		viewsignature;
+static int		viewlevel;
+static sector_t*	viewsectors;
+THREADLOCAL int			linecount;
+THREADLOCAL int			loopcount;
 
 fixed_t			viewx;
 fixed_t			viewy;
@@ -106,8 +151,10 @@ int			extralight;
 
 
 
-void (*colfunc) (void);
+THREADLOCAL void (*colfunc) (void);
 void (*basecolfunc) (void);
+void (*nonpow2colfunc) (void);
+void (*postcolfunc) (void);
 void (*fuzzcolfunc) (void);
 void (*transcolfunc) (void);
 void (*spanfunc) (void);
@@ -697,17 +744,21 @@ void R_ExecuteSetViewSize (void)
 
     if (!detailshift)
     {
-	colfunc = basecolfunc = R_DrawColumn;
+	colfunc = basecolfunc = drawcolumn;
+	nonpow2colfunc = drawnonpow2column;
+	postcolfunc = drawpostcolumn;
 	fuzzcolfunc = R_DrawFuzzColumn;
-	transcolfunc = R_DrawTranslatedColumn;
-	spanfunc = R_DrawSpan;
+	transcolfunc = drawtranslatedcolumn;
+	spanfunc = drawspan;
     }
     else
     {
-	colfunc = basecolfunc = R_DrawColumnLow;
+	colfunc = basecolfunc = drawcolumnlow;
+	nonpow2colfunc = drawnonpow2columnlow;
+	postcolfunc = drawpostcolumnlow;
 	fuzzcolfunc = R_DrawFuzzColumnLow;
 	transcolfunc = R_DrawTranslatedColumnLow;
-	spanfunc = R_DrawSpanLow;
+	spanfunc = drawspanlow;
     }
 
     R_InitBuffer (scaledviewwidth, viewheight);
@@ -758,6 +809,248 @@ void R_ExecuteSetViewSize (void)
 
 
 
+//
+// R_RenderStrip
+// Renders the view, drawing only the columns of one strip.
+//
+static void R_RenderStrip (int strip)
+{
+    stripx1 = strip*viewwidth/numrenderthreads;
+    stripx2 = (strip+1)*viewwidth/numrenderthreads - 1;
+
+    // Start from the same state as the main thread
+    colfunc = basecolfunc;
+    fuzzpos = renderfuzzpos;
+
+    if (fixedcolormap)
+	walllights = scalelightfixed;
+
+    R_ClearClipSegs ();
+    R_ClearDrawSegs ();
+    R_ClearPlanes ();
+    R_ClearSprites ();
+    R_RenderBSPNode (numnodes-1);
+    R_DrawPlanes ();
+    R_DrawMasked ();
+}
+
+
+//
+// R_RenderThread
+// Renders strip 1 and up, once per frame.
+//
+static void *R_RenderThread (void *arg)
+{
+    int		strip;
+    int		generation;
+    sigset_t	signals;
+
+    strip = (intptr_t) arg;
+    generation = 0;
+
+    // Signals are left to the main thread
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    for (;;)
+    {
+	pthread_mutex_lock(&rendermutex);
+	while (rendergeneration == generation)
+	    pthread_cond_wait(&renderstart, &rendermutex);
+	generation = rendergeneration;
+	pthread_mutex_unlock(&rendermutex);
+
+	R_RenderStrip (strip);
+
+	pthread_mutex_lock(&rendermutex);
+	if (--renderpending == 0)
+	    pthread_cond_signal(&renderdone);
+	pthread_mutex_unlock(&rendermutex);
+    }
+
+    return NULL;
+}
+
+
+//
+// R_RenderParallel
+// Renders the view on all render threads,
+//  with the main thread taking strip 0.
+//
+static void R_RenderParallel (void)
+{
+    // check for new console commands.
+    NetUpdate ();
+
+    R_PinCache ();
+    renderfuzzpos = fuzzpos;
+
+    pthread_mutex_lock(&rendermutex);
+    renderpending = numrenderthreads-1;
+    rendergeneration++;
+    pthread_cond_broadcast(&renderstart);
+    pthread_mutex_unlock(&rendermutex);
+
+    R_RenderStrip (0);
+
+    pthread_mutex_lock(&rendermutex);
+    while (renderpending)
+	pthread_cond_wait(&renderdone, &rendermutex);
+    pthread_mutex_unlock(&rendermutex);
+
+    R_UnpinCache ();
+
+    // Check for new console commands.
+    NetUpdate ();
+}
+
+
+//
+// R_InitRenderThreads
+//
+static void R_InitRenderThreads (void)
+{
+    int		i;
+    int		p;
+
+    //!
+    // @arg <n>
+    //
+    // Render the view on n threads, each drawing a vertical strip
+    // of it. The result is identical to rendering on one thread.
+    //
+
+    p = M_CheckParmWithArgs("-renderthreads", 1);
+
+    if (p > 0)
+    {
+	numrenderthreads = atoi(myargv[p+1]);
+
+	if (numrenderthreads < 1)
+	    numrenderthreads = 1;
+	else if (numrenderthreads > MAXRENDERTHREADS)
+	    numrenderthreads = MAXRENDERTHREADS;
+    }
+
+    for (i=1 ; i<numrenderthreads ; i++)
+    {
+	if (pthread_create(&renderthreads[i], NULL,
+			   R_RenderThread, (void *) (intptr_t) i))
+	{
+	    I_Error ("R_InitRenderThreads: failed to start thread %i", i);
+	}
+    }
+}
+
+
+
+//
+// R_TextureColumnFunc
+// Returns the drawer that wraps columns at the given
+//  texture height, to be set in dc_texheight.
+//
+void (*R_TextureColumnFunc (int height)) (void)
+{
+    if (height & (height-1))
+	return nonpow2colfunc;
+
+    return basecolfunc;
+}
+
+
+
+//
+// R_ViewSignature
+// Hashes the view, the sectors and sides the last walk reached,
+//  and the things and player sprites drawn from them. Returns 0
+//  when something fuzzy is in view, as fuzz differs every frame.
+//
+#define SIGNATURE(s, v)		((s) = ((s) ^ (uint32_t) (v)) * 0x100000001b3ULL)
+
+static uint64_t R_ViewSignature (void)
+{
+    uint64_t	s;
+    int		i;
+    sector_t*	sec;
+    side_t*	side;
+    mobj_t*	thing;
+    pspdef_t*	psp;
+
+    if (viewplayer->powers[pw_invisibility])
+	return 0;
+
+    s = 0xcbf29ce484222325ULL;
+
+    SIGNATURE(s, viewx);
+    SIGNATURE(s, viewy);
+    SIGNATURE(s, viewz);
+    SIGNATURE(s, viewangle);
+    SIGNATURE(s, extralight);
+    SIGNATURE(s, viewplayer->fixedcolormap);
+    SIGNATURE(s, viewwindowx);
+    SIGNATURE(s, viewwindowy);
+    SIGNATURE(s, scaledviewwidth);
+    SIGNATURE(s, viewheight);
+    SIGNATURE(s, detailshift);
+    SIGNATURE(s, skytexture);
+
+    for (i=0, psp=viewplayer->psprites ; i<NUMPSPRITES ; i++, psp++)
+    {
+	SIGNATURE(s, psp->state ? psp->state - states : -1);
+	SIGNATURE(s, psp->sx);
+	SIGNATURE(s, psp->sy);
+    }
+
+    for (i=0 ; i<numseensectors ; i++)
+    {
+	sec = &sectors[seensectors[i]];
+
+	SIGNATURE(s, sec->floorheight);
+	SIGNATURE(s, sec->ceilingheight);
+	SIGNATURE(s, flattranslation[sec->floorpic]);
+	SIGNATURE(s, flattranslation[sec->ceilingpic]);
+	SIGNATURE(s, sec->lightlevel);
+
+	for (thing = sec->thinglist ; thing ; thing = thing->snext)
+	{
+	    if (thing->flags & MF_SHADOW)
+		return 0;
+
+	    SIGNATURE(s, thing->x);
+	    SIGNATURE(s, thing->y);
+	    SIGNATURE(s, thing->z);
+	    SIGNATURE(s, thing->angle);
+	    SIGNATURE(s, thing->sprite);
+	    SIGNATURE(s, thing->frame);
+	    SIGNATURE(s, thing->flags);
+	}
+    }
+
+    for (i=0 ; i<numseensides ; i++)
+    {
+	side = &sides[seensides[i]];
+
+	SIGNATURE(s, side->textureoffset);
+	SIGNATURE(s, side->rowoffset);
+	SIGNATURE(s, texturetranslation[side->toptexture]);
+	SIGNATURE(s, texturetranslation[side->bottomtexture]);
+	SIGNATURE(s, texturetranslation[side->midtexture]);
+    }
+
+    return s ? s : 1;
+}
+
+
+//
+// R_ReportViews
+//
+static void R_ReportViews (void)
+{
+    printf ("R_RenderPlayerView: %i of %i views reused\n",
+	    reusedviews, numviews);
+}
+
+
 //
 // R_Init
 //
@@ -781,7 +1074,21 @@ void R_Init (void)
     printf (".");
     R_InitSkyMap ();
     R_InitTranslationTables ();
+    R_InitDrawers ();
+    R_InitRenderThreads ();
     printf (".");
+
+    //!
+    // @category video
+    //
+    // Show the last view drawn again, instead of drawing it,
+    // while nothing it depends on has changed.
+    //
+
+    reuseview = M_CheckParm("-reuseview") > 0;
+
+    if (reuseview)
+	I_AtExit (R_ReportViews, true);
 	
     framecount = 0;
 }
@@ -856,13 +1163,14 @@ void R_SetupFrame (player_t* player)
 }
 
 
-
 //
-// R_RenderView
+// R_RenderSerial
+// Renders the whole view on this thread.
 //
-void R_RenderPlayerView (player_t* player)
-{	
-    R_SetupFrame (player);
+static void R_RenderSerial (void)
+{
+    stripx1 = 0;
+    stripx2 = viewwidth-1;
 
     // Clear buffers.
     R_ClearClipSegs ();
@@ -889,3 +1197,51 @@ void R_RenderPlayerView (player_t* player)
     // Check for new console commands.
     NetUpdate ();				
 }
+
+
+//
+// R_RenderView
+//
+void R_RenderPlayerView (player_t* player)
+{	
+    R_SetupFrame (player);
+
+    numviews++;
+
+    if (reuseview)
+    {
+	// Nothing the last view depends on has changed?
+	// The lists of what it reached are only valid
+	//  on the level it was drawn on.
+	if (viewsignature
+	    && viewlevel == levelstarttic
+	    && viewsectors == sectors
+	    && R_ViewSignature () == viewsignature)
+	{
+	    R_RestoreView ();
+	    V_MarkRect (viewwindowx, viewwindowy, scaledviewwidth, viewheight);
+	    reusedviews++;
+	    return;
+	}
+
+	R_ClearSeen ();
+    }
+
+    if (numrenderthreads > 1)
+	R_RenderParallel ();
+    else
+	R_RenderSerial ();
+
+    if (columnmajor)
+	R_TransposeView ();
+
+    V_MarkRect (viewwindowx, viewwindowy, scaledviewwidth, viewheight);
+
+    if (reuseview)
+    {
+	viewsignature = R_ViewSignature ();
+	viewlevel = levelstarttic;
+	viewsectors = sectors;
+	R_SaveView ();
+    }
+}
@@ -45,9 +45,18 @@ extern fixed_t		centeryfrac;
 extern fixed_t		projection;
 
 extern int		validcount;
+extern int		framecount;
 
-extern int		linecount;
-extern int		loopcount;
+extern int		numrenderthreads;
+
+// The last view drawn is shown again while nothing
+//  it depends on changes.
+extern boolean		reuseview;
+extern int		numviews;
+extern int		reusedviews;
+
+extern THREADLOCAL int		linecount;
+extern THREADLOCAL int		loopcount;
 
 
 //
@@ -89,9 +98,13 @@ extern	int		detailshift;
 // Function pointers to switch refresh/drawing functions.
 // Used to select shadow mode etc.
 //
-extern void		(*colfunc) (void);
+extern THREADLOCAL void		(*colfunc) (void);
 extern void		(*transcolfunc) (void);
 extern void		(*basecolfunc) (void);
+// Walls with textures of other than power of two height.
+extern void		(*nonpow2colfunc) (void);
+// Posts of sprites and masked textures.
+extern void		(*postcolfunc) (void);
 extern void		(*fuzzcolfunc) (void);
 // No shadow effects on floors.
 extern void		(*spanfunc) (void);
@@ -142,6 +155,9 @@ R_AddPointToBox
   int		y,
   fixed_t*	box );
 
+// Drawer for columns of a texture of the given height.
+void (*R_TextureColumnFunc (int height)) (void);
+
 
 
 //
@@ -42,16 +42,24 @@ planefunction_t		ceilingfunc;
 //
 
 // Here comes the obnoxious "visplane".
-#define MAXVISPLANES	128
-visplane_t		visplanes[MAXVISPLANES];
-visplane_t*		lastvisplane;
-visplane_t*		floorplane;
-visplane_t*		ceilingplane;
-
-// ?
+// Visplanes are hashed on height, picnum and lightlevel,
+//  allocated as needed and kept on a free list between frames.
+// Heights are whole units in practice, so their fraction is dropped.
+#define VISPLANEHASHSIZE	128
+#define VISPLANEHASH(height,picnum,lightlevel) \
+    ((((unsigned)(height)>>FRACBITS)*7 + (picnum)*3 + (lightlevel)) \
+     & (VISPLANEHASHSIZE-1))
+
+THREADLOCAL visplane_t*		visplanes[VISPLANEHASHSIZE];
+THREADLOCAL visplane_t*		freevisplanes;
+THREADLOCAL visplane_t*		floorplane;
+THREADLOCAL visplane_t*		ceilingplane;
+
+// Openings start out this big, and double when they run out.
 #define MAXOPENINGS	SCREENWIDTH*64
-short			openings[MAXOPENINGS];
-short*			lastopening;
+THREADLOCAL short*			openings;
+THREADLOCAL int			numopenings;
+THREADLOCAL short*			lastopening;
 
 
 //
@@ -59,31 +67,31 @@ short*			lastopening;
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 //
-short			floorclip[SCREENWIDTH];
-short			ceilingclip[SCREENWIDTH];
+THREADLOCAL short			floorclip[SCREENWIDTH];
+THREADLOCAL short			ceilingclip[SCREENWIDTH];
 
 //
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int			spanstart[SCREENHEIGHT];
-int			spanstop[SCREENHEIGHT];
+THREADLOCAL int			spanstart[SCREENHEIGHT];
+THREADLOCAL int			spanstop[SCREENHEIGHT];
 
 //
 // texture mapping
 //
-lighttable_t**		planezlight;
-fixed_t			planeheight;
+THREADLOCAL lighttable_t**		planezlight;
+THREADLOCAL fixed_t			planeheight;
 
 fixed_t			yslope[SCREENHEIGHT];
 fixed_t			distscale[SCREENWIDTH];
-fixed_t			basexscale;
-fixed_t			baseyscale;
+THREADLOCAL fixed_t			basexscale;
+THREADLOCAL fixed_t			baseyscale;
 
-fixed_t			cachedheight[SCREENHEIGHT];
-fixed_t			cacheddistance[SCREENHEIGHT];
-fixed_t			cachedxstep[SCREENHEIGHT];
-fixed_t			cachedystep[SCREENHEIGHT];
+THREADLOCAL fixed_t			cachedheight[SCREENHEIGHT];
+THREADLOCAL fixed_t			cacheddistance[SCREENHEIGHT];
+THREADLOCAL fixed_t			cachedxstep[SCREENHEIGHT];
+THREADLOCAL fixed_t			cachedystep[SCREENHEIGHT];
 
 
 
@@ -131,6 +139,10 @@ R_MapPlane
     }
 #endif
 
+    // Left to the thread whose strip this is
+    if (x2 < stripx1 || x1 > stripx2)
+	return;
+
     if (planeheight != cachedheight[y])
     {
 	cachedheight[y] = planeheight;
@@ -166,6 +178,12 @@ R_MapPlane
     ds_x1 = x1;
     ds_x2 = x2;
 
+    // clip to this thread's strip
+    if (ds_x1 < stripx1)
+	R_SkipSpan (stripx1 - ds_x1);
+    if (ds_x2 > stripx2)
+	ds_x2 = stripx2;
+
     // high or low detail
     spanfunc ();	
 }
@@ -179,6 +197,7 @@ void R_ClearPlanes (void)
 {
     int		i;
     angle_t	angle;
+    visplane_t*	pl;
     
     // opening / clipping determination
     for (i=0 ; i<viewwidth ; i++)
@@ -187,7 +206,27 @@ void R_ClearPlanes (void)
 	ceilingclip[i] = -1;
     }
 
-    lastvisplane = visplanes;
+    // free all visplanes
+    for (i=0 ; i<VISPLANEHASHSIZE ; i++)
+    {
+	while (visplanes[i])
+	{
+	    pl = visplanes[i];
+	    visplanes[i] = pl->next;
+	    pl->next = freevisplanes;
+	    freevisplanes = pl;
+	}
+    }
+
+    if (!openings)
+    {
+	numopenings = MAXOPENINGS;
+	openings = malloc(numopenings * sizeof(*openings));
+
+	if (!openings)
+	    I_Error ("R_ClearPlanes: out of memory");
+    }
+
     lastopening = openings;
     
     // texture calculation
@@ -204,6 +243,94 @@ void R_ClearPlanes (void)
 
 
 
+//
+// R_CheckOpenings
+// Makes room for count more openings. If they have to move,
+//  the drawsegs that point into them are moved along.
+//
+void R_CheckOpenings (int count)
+{
+    short*	oldopenings;
+    drawseg_t*	ds;
+
+    if (lastopening - openings + count <= numopenings)
+	return;
+
+    while (lastopening - openings + count > numopenings)
+	numopenings *= 2;
+
+    oldopenings = openings;
+    openings = malloc(numopenings * sizeof(*openings));
+
+    if (!openings)
+	I_Error ("R_CheckOpenings: out of memory (%i openings)", numopenings);
+
+    memcpy (openings, oldopenings, (lastopening - oldopenings) * sizeof(*openings));
+
+#define REBASE(p) \
+    if (ds->p && ds->p + ds->x1 >= oldopenings \
+	&& ds->p + ds->x1 < lastopening) \
+	ds->p = openings + (ds->p - oldopenings)
+
+    // clip arrays may also point to screenheightarray or negonearray
+    for (ds = drawsegs ; ds < ds_p ; ds++)
+    {
+	REBASE(maskedtexturecol);
+	REBASE(sprtopclip);
+	REBASE(sprbottomclip);
+    }
+
+#undef REBASE
+
+    lastopening = openings + (lastopening - oldopenings);
+    free (oldopenings);
+}
+
+
+//
+// R_NewPlane
+// Takes a visplane off the free list, or allocates one,
+//  and appends it to its hash chain.
+//
+static visplane_t*
+R_NewPlane
+( fixed_t	height,
+  int		picnum,
+  int		lightlevel )
+{
+    visplane_t*		pl;
+    visplane_t**	chain;
+
+    pl = freevisplanes;
+
+    if (pl)
+    {
+	freevisplanes = pl->next;
+    }
+    else
+    {
+	pl = malloc(sizeof(*pl));
+
+	if (!pl)
+	    I_Error ("R_NewPlane: out of memory");
+    }
+
+    // Appended, so R_FindPlane finds the oldest plane first
+    //  just like a scan of the vanilla visplane array.
+    chain = &visplanes[VISPLANEHASH(height, picnum, lightlevel)];
+    while (*chain)
+	chain = &(*chain)->next;
+    *chain = pl;
+
+    pl->next = NULL;
+    pl->height = height;
+    pl->picnum = picnum;
+    pl->lightlevel = lightlevel;
+
+    return pl;
+}
+
+
 //
 // R_FindPlane
 //
@@ -221,28 +348,19 @@ R_FindPlane
 	lightlevel = 0;
     }
 	
-    for (check=visplanes; check<lastvisplane; check++)
+    for (check = visplanes[VISPLANEHASH(height, picnum, lightlevel)];
+	 check;
+	 check = check->next)
     {
 	if (height == check->height
 	    && picnum == check->picnum
 	    && lightlevel == check->lightlevel)
 	{
-	    break;
+	    return check;
 	}
     }
     
-			
-    if (check < lastvisplane)
-	return check;
-		
-    if (lastvisplane - visplanes == MAXVISPLANES)
-	I_Error ("R_FindPlane: no more visplanes");
-		
-    lastvisplane++;
-
-    check->height = height;
-    check->picnum = picnum;
-    check->lightlevel = lightlevel;
+    check = R_NewPlane (height, picnum, lightlevel);
     check->minx = SCREENWIDTH;
     check->maxx = -1;
     
@@ -303,11 +421,7 @@ R_CheckPlane
     }
 	
     // make a new visplane
-    lastvisplane->height = pl->height;
-    lastvisplane->picnum = pl->picnum;
-    lastvisplane->lightlevel = pl->lightlevel;
-    
-    pl = lastvisplane++;
+    pl = R_NewPlane (pl->height, pl->picnum, pl->lightlevel);
     pl->minx = start;
     pl->maxx = stop;
 
@@ -360,31 +474,31 @@ R_MakeSpans
 void R_DrawPlanes (void)
 {
     visplane_t*		pl;
+    int			i;
     int			light;
     int			x;
+    int			start;
     int			stop;
     int			angle;
     int                 lumpnum;
+    void		(*skycolfunc) (void);
 				
 #ifdef RANGECHECK
-    if (ds_p - drawsegs > MAXDRAWSEGS)
-	I_Error ("R_DrawPlanes: drawsegs overflow (%i)",
-		 ds_p - drawsegs);
-    
-    if (lastvisplane - visplanes > MAXVISPLANES)
-	I_Error ("R_DrawPlanes: visplane overflow (%i)",
-		 lastvisplane - visplanes);
-    
-    if (lastopening - openings > MAXOPENINGS)
+    if (lastopening - openings > numopenings)
 	I_Error ("R_DrawPlanes: opening overflow (%i)",
 		 lastopening - openings);
 #endif
 
-    for (pl = visplanes ; pl < lastvisplane ; pl++)
+    for (i=0 ; i<VISPLANEHASHSIZE ; i++)
+    for (pl = visplanes[i] ; pl ; pl = pl->next)
     {
 	if (pl->minx > pl->maxx)
 	    continue;
 
+	// not in this thread's strip
+	if (pl->maxx < stripx1 || pl->minx > stripx2)
+	    continue;
+
 	
 	// sky flat
 	if (pl->picnum == skyflatnum)
@@ -397,7 +511,11 @@ void R_DrawPlanes (void)
 	    //  by INVUL inverse mapping.
 	    dc_colormap = colormaps;
 	    dc_texturemid = skytexturemid;
-	    for (x=pl->minx ; x <= pl->maxx ; x++)
+	    dc_texheight = textureheight[skytexture]>>FRACBITS;
+	    skycolfunc = R_TextureColumnFunc (dc_texheight);
+	    start = pl->minx < stripx1 ? stripx1 : pl->minx;
+	    stop = pl->maxx > stripx2 ? stripx2 : pl->maxx;
+	    for (x=start ; x <= stop ; x++)
 	    {
 		dc_yl = pl->top[x];
 		dc_yh = pl->bottom[x];
@@ -407,7 +525,7 @@ void R_DrawPlanes (void)
 		    angle = (viewangle + xtoviewangle[x])>>ANGLETOSKYSHIFT;
 		    dc_x = x;
 		    dc_source = R_GetColumn(skytexture, angle);
-		    colfunc ();
+		    skycolfunc ();
 		}
 	    }
 	    continue;
@@ -415,7 +533,7 @@ void R_DrawPlanes (void)
 	
 	// regular flat
         lumpnum = firstflat + flattranslation[pl->picnum];
-	ds_source = W_CacheLumpNum(lumpnum, PU_STATIC);
+	ds_source = R_CacheLumpNum(lumpnum, PU_STATIC);
 	
 	planeheight = abs(pl->height-viewz);
 	light = (pl->lightlevel >> LIGHTSEGSHIFT)+extralight;
@@ -441,6 +559,6 @@ void R_DrawPlanes (void)
 			pl->bottom[x]);
 	}
 	
-        W_ReleaseLumpNum(lumpnum);
+        R_ReleaseLumpNum(lumpnum);
     }
 }
@@ -26,7 +26,7 @@
 
 
 // Visplane related.
-extern  short*		lastopening;
+extern THREADLOCAL short*		lastopening;
 
 
 typedef void (*planefunction_t) (int top, int bottom);
@@ -34,8 +34,8 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t	floorfunc;
 extern planefunction_t	ceilingfunc_t;
 
-extern short		floorclip[SCREENWIDTH];
-extern short		ceilingclip[SCREENWIDTH];
+extern THREADLOCAL short		floorclip[SCREENWIDTH];
+extern THREADLOCAL short		ceilingclip[SCREENWIDTH];
 
 extern fixed_t		yslope[SCREENHEIGHT];
 extern fixed_t		distscale[SCREENWIDTH];
@@ -71,6 +71,8 @@ R_CheckPlane
   int		start,
   int		stop );
 
+void R_CheckOpenings (int count);
+
 
 
 #endif
@@ -36,56 +36,56 @@
 // OPTIMIZE: closed two sided lines as single sided
 
 // True if any of the segs textures might be visible.
-boolean		segtextured;	
+THREADLOCAL boolean		segtextured;	
 
 // False if the back side is the same plane.
-boolean		markfloor;	
-boolean		markceiling;
+THREADLOCAL boolean		markfloor;	
+THREADLOCAL boolean		markceiling;
 
-boolean		maskedtexture;
-int		toptexture;
-int		bottomtexture;
-int		midtexture;
+THREADLOCAL boolean		maskedtexture;
+THREADLOCAL int		toptexture;
+THREADLOCAL int		bottomtexture;
+THREADLOCAL int		midtexture;
 
 
-angle_t		rw_normalangle;
+THREADLOCAL angle_t		rw_normalangle;
 // angle to line origin
-int		rw_angle1;	
+THREADLOCAL int		rw_angle1;	
 
 //
 // regular wall
 //
-int		rw_x;
-int		rw_stopx;
-angle_t		rw_centerangle;
-fixed_t		rw_offset;
-fixed_t		rw_distance;
-fixed_t		rw_scale;
-fixed_t		rw_scalestep;
-fixed_t		rw_midtexturemid;
-fixed_t		rw_toptexturemid;
-fixed_t		rw_bottomtexturemid;
+THREADLOCAL int		rw_x;
+THREADLOCAL int		rw_stopx;
+THREADLOCAL angle_t		rw_centerangle;
+THREADLOCAL fixed_t		rw_offset;
+THREADLOCAL fixed_t		rw_distance;
+THREADLOCAL fixed_t		rw_scale;
+THREADLOCAL fixed_t		rw_scalestep;
+THREADLOCAL fixed_t		rw_midtexturemid;
+THREADLOCAL fixed_t		rw_toptexturemid;
+THREADLOCAL fixed_t		rw_bottomtexturemid;
 
-int		worldtop;
-int		worldbottom;
-int		worldhigh;
-int		worldlow;
+THREADLOCAL int		worldtop;
+THREADLOCAL int		worldbottom;
+THREADLOCAL int		worldhigh;
+THREADLOCAL int		worldlow;
 
-fixed_t		pixhigh;
-fixed_t		pixlow;
-fixed_t		pixhighstep;
-fixed_t		pixlowstep;
+THREADLOCAL fixed_t		pixhigh;
+THREADLOCAL fixed_t		pixlow;
+THREADLOCAL fixed_t		pixhighstep;
+THREADLOCAL fixed_t		pixlowstep;
 
-fixed_t		topfrac;
-fixed_t		topstep;
+THREADLOCAL fixed_t		topfrac;
+THREADLOCAL fixed_t		topstep;
 
-fixed_t		bottomfrac;
-fixed_t		bottomstep;
+THREADLOCAL fixed_t		bottomfrac;
+THREADLOCAL fixed_t		bottomstep;
 
 
-lighttable_t**	walllights;
+THREADLOCAL lighttable_t**	walllights;
 
-short*		maskedtexturecol;
+THREADLOCAL short*		maskedtexturecol;
 
 
 
@@ -102,6 +102,14 @@ R_RenderMaskedSegRange
     column_t*	col;
     int		lightnum;
     int		texnum;
+
+    // Only this thread's strip is drawn
+    if (x1 < stripx1)
+	x1 = stripx1;
+    if (x2 > stripx2)
+	x2 = stripx2;
+    if (x1 > x2)
+	return;
     
     // Calculate light table.
     // Use different light tables
@@ -150,6 +158,8 @@ R_RenderMaskedSegRange
 			
     if (fixedcolormap)
 	dc_colormap = fixedcolormap;
+
+    colfunc = postcolfunc;
     
     // draw the columns
     for (dc_x = x1 ; dc_x <= x2 ; dc_x++)
@@ -172,13 +182,15 @@ R_RenderMaskedSegRange
 	    
 	    // draw the texture
 	    col = (column_t *)( 
-		(byte *)R_GetColumn(texnum,maskedtexturecol[dc_x]) -3);
+		(byte *)R_GetMaskedColumn(texnum,maskedtexturecol[dc_x]) -3);
 			
 	    R_DrawMaskedColumn (col);
 	    maskedtexturecol[dc_x] = SHRT_MAX;
 	}
 	spryscale += rw_scalestep;
     }
+
+    colfunc = basecolfunc;
 	
 }
 
@@ -206,9 +218,28 @@ void R_RenderSegLoop (void)
     fixed_t		texturecolumn;
     int			top;
     int			bottom;
+    boolean		instrip;
+    int			midheight;
+    int			topheight;
+    int			bottomheight;
+    void		(*midcolfunc) (void);
+    void		(*topcolfunc) (void);
+    void		(*bottomcolfunc) (void);
+
+    // Each tier wraps at the height of its own texture
+    midheight = textureheight[midtexture]>>FRACBITS;
+    topheight = textureheight[toptexture]>>FRACBITS;
+    bottomheight = textureheight[bottomtexture]>>FRACBITS;
+    midcolfunc = R_TextureColumnFunc (midheight);
+    topcolfunc = R_TextureColumnFunc (topheight);
+    bottomcolfunc = R_TextureColumnFunc (bottomheight);
 
     for ( ; rw_x < rw_stopx ; rw_x++)
     {
+	// Columns outside the strip are clipped but not drawn
+	instrip = rw_x >= stripx1 && rw_x <= stripx2;
+
+
 	// mark floor / ceiling areas
 	yl = (topfrac+HEIGHTUNIT-1)>>HEIGHTBITS;
 
@@ -280,8 +311,12 @@ void R_RenderSegLoop (void)
 	    dc_yl = yl;
 	    dc_yh = yh;
 	    dc_texturemid = rw_midtexturemid;
-	    dc_source = R_GetColumn(midtexture,texturecolumn);
-	    colfunc ();
+	    if (instrip)
+	    {
+		dc_source = R_GetColumn(midtexture,texturecolumn);
+		dc_texheight = midheight;
+		midcolfunc ();
+	    }
 	    ceilingclip[rw_x] = viewheight;
 	    floorclip[rw_x] = -1;
 	}
@@ -302,8 +337,12 @@ void R_RenderSegLoop (void)
 		    dc_yl = yl;
 		    dc_yh = mid;
 		    dc_texturemid = rw_toptexturemid;
-		    dc_source = R_GetColumn(toptexture,texturecolumn);
-		    colfunc ();
+		    if (instrip)
+		    {
+			dc_source = R_GetColumn(toptexture,texturecolumn);
+			dc_texheight = topheight;
+			topcolfunc ();
+		    }
 		    ceilingclip[rw_x] = mid;
 		}
 		else
@@ -331,9 +370,13 @@ void R_RenderSegLoop (void)
 		    dc_yl = mid;
 		    dc_yh = yh;
 		    dc_texturemid = rw_bottomtexturemid;
-		    dc_source = R_GetColumn(bottomtexture,
-					    texturecolumn);
-		    colfunc ();
+		    if (instrip)
+		    {
+			dc_source = R_GetColumn(bottomtexture,
+						texturecolumn);
+			dc_texheight = bottomheight;
+			bottomcolfunc ();
+		    }
 		    floorclip[rw_x] = mid;
 		}
 		else
@@ -379,9 +422,7 @@ R_StoreWallRange
     fixed_t		vtop;
     int			lightnum;
 
-    // don't overflow and crash
-    if (ds_p == &drawsegs[MAXDRAWSEGS])
-	return;		
+    R_CheckDrawSegs ();
 		
 #ifdef RANGECHECK
     if (start >=viewwidth || start > stop)
@@ -391,8 +432,10 @@ R_StoreWallRange
     sidedef = curline->sidedef;
     linedef = curline->linedef;
 
-    // mark the segment as visible for auto map
-    linedef->flags |= ML_MAPPED;
+    // mark the segment as visible for auto map,
+    //  from the first render thread only, as every thread sees it
+    if (stripx1 == 0)
+	linedef->flags |= ML_MAPPED;
     
     // calculate rw_distance for scale calculation
     rw_normalangle = curline->angle + ANG90;
@@ -411,6 +454,9 @@ R_StoreWallRange
     ds_p->x2 = stop;
     ds_p->curline = curline;
     rw_stopx = stop+1;
+
+    // room for the masked texture and both clip arrays
+    R_CheckOpenings (3*(rw_stopx-start));
     
     // calculate scale at both ends and step
     ds_p->scale1 = rw_scale = 
@@ -738,6 +784,11 @@ R_StoreWallRange
 	ds_p->silhouette |= SIL_BOTTOM;
 	ds_p->bsilheight = INT_MAX;
     }
+
+    // only these can clip sprites
+    if (ds_p->silhouette || ds_p->maskedtexturecol)
+	R_IndexDrawSeg (ds_p);
+
     ds_p++;
 }
 
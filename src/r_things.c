@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "deh_main.h"
@@ -68,7 +69,7 @@ typedef struct
 fixed_t		pspritescale;
 fixed_t		pspriteiscale;
 
-lighttable_t**	spritelights;
+THREADLOCAL lighttable_t**	spritelights;
 
 // constant arrays
 //  used for psprite clipping and initializing clipping
@@ -278,9 +279,19 @@ void R_InitSpriteDefs (char** namelist)
 //
 // GAME FUNCTIONS
 //
-vissprite_t	vissprites[MAXVISSPRITES];
-vissprite_t*	vissprite_p;
-int		newvissprite;
+THREADLOCAL vissprite_t*	vissprites;
+static THREADLOCAL int	numvissprites;
+
+// for R_SortVisSprites
+static THREADLOCAL vissprite_t**	sortedsprites;
+static THREADLOCAL vissprite_t**	mergesprites;
+
+// framecount at which each sector's things were last added
+static THREADLOCAL int*	spritesectors;
+static THREADLOCAL int	numspritesectors;
+
+THREADLOCAL vissprite_t*	vissprite_p;
+THREADLOCAL int		newvissprite;
 
 
 
@@ -314,13 +325,29 @@ void R_ClearSprites (void)
 
 //
 // R_NewVisSprite
+// The pool doubles when full, instead of dropping sprites.
 //
-vissprite_t	overflowsprite;
-
 vissprite_t* R_NewVisSprite (void)
 {
-    if (vissprite_p == &vissprites[MAXVISSPRITES])
-	return &overflowsprite;
+    int		count;
+
+    count = vissprite_p - vissprites;
+
+    if (count == numvissprites)
+    {
+	numvissprites = numvissprites ? numvissprites*2 : MAXVISSPRITES;
+	vissprites = realloc(vissprites, numvissprites * sizeof(*vissprites));
+	sortedsprites = realloc(sortedsprites,
+				numvissprites * sizeof(*sortedsprites));
+	mergesprites = realloc(mergesprites,
+			       numvissprites * sizeof(*mergesprites));
+
+	if (!vissprites || !sortedsprites || !mergesprites)
+	    I_Error ("R_NewVisSprite: out of memory (%i vissprites)",
+		     numvissprites);
+
+	vissprite_p = vissprites + count;
+    }
     
     vissprite_p++;
     return vissprite_p-1;
@@ -334,11 +361,11 @@ vissprite_t* R_NewVisSprite (void)
 // Masked means: partly transparent, i.e. stored
 //  in posts/runs of opaque pixels.
 //
-short*		mfloorclip;
-short*		mceilingclip;
+THREADLOCAL short*		mfloorclip;
+THREADLOCAL short*		mceilingclip;
 
-fixed_t		spryscale;
-fixed_t		sprtopscreen;
+THREADLOCAL fixed_t		spryscale;
+THREADLOCAL fixed_t		sprtopscreen;
 
 void R_DrawMaskedColumn (column_t* column)
 {
@@ -369,7 +396,7 @@ void R_DrawMaskedColumn (column_t* column)
 	    dc_texturemid = basetexturemid - (column->topdelta<<FRACBITS);
 	    // dc_source = (byte *)column + 3 - column->topdelta;
 
-	    // Drawn by either R_DrawColumn
+	    // Drawn by either R_DrawPostColumn
 	    //  or (SHADOW) R_DrawFuzzColumn.
 	    colfunc ();	
 	}
@@ -395,9 +422,27 @@ R_DrawVisSprite
     int			texturecolumn;
     fixed_t		frac;
     patch_t*		patch;
-	
-	
-    patch = W_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
+
+    x1 = vis->x1;
+    x2 = vis->x2;
+    frac = vis->startfrac;
+
+    // Shadows step through every column, so the fuzz pattern lines
+    //  up with a full render. Anything else is only drawn in the strip.
+    if (vis->colormap)
+    {
+	if (x1 < stripx1)
+	{
+	    frac += vis->xiscale*(stripx1-x1);
+	    x1 = stripx1;
+	}
+	if (x2 > stripx2)
+	    x2 = stripx2;
+	if (x1 > x2)
+	    return;
+    }
+
+    patch = R_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
 
     dc_colormap = vis->colormap;
     
@@ -412,14 +457,17 @@ R_DrawVisSprite
 	dc_translation = translationtables - 256 +
 	    ( (vis->mobjflags & MF_TRANSLATION) >> (MF_TRANSSHIFT-8) );
     }
+    else
+    {
+	colfunc = postcolfunc;
+    }
 	
     dc_iscale = abs(vis->xiscale)>>detailshift;
     dc_texturemid = vis->texturemid;
-    frac = vis->startfrac;
     spryscale = vis->scale;
     sprtopscreen = centeryfrac - FixedMul(dc_texturemid,spryscale);
 	
-    for (dc_x=vis->x1 ; dc_x<=vis->x2 ; dc_x++, frac += vis->xiscale)
+    for (dc_x=x1 ; dc_x<=x2 ; dc_x++, frac += vis->xiscale)
     {
 	texturecolumn = frac>>FRACBITS;
 #ifdef RANGECHECK
@@ -611,11 +659,22 @@ void R_AddSprites (sector_t* sec)
     // A sector might have been split into several
     //  subsectors during BSP building.
     // Thus we check whether its already added.
-    if (sec->validcount == validcount)
+    // Every render thread traverses the BSP, so it keeps its own marks.
+    if (numsectors > numspritesectors)
+    {
+	spritesectors = realloc(spritesectors, numsectors * sizeof(*spritesectors));
+	if (spritesectors == NULL)
+	    I_Error ("R_AddSprites: out of memory");
+	memset(spritesectors + numspritesectors, 0,
+	       (numsectors - numspritesectors) * sizeof(*spritesectors));
+	numspritesectors = numsectors;
+    }
+
+    if (spritesectors[sec - sectors] == framecount)
 	return;		
 
     // Well, now it will be done.
-    sec->validcount = validcount;
+    spritesectors[sec - sectors] = framecount;
 	
     lightnum = (sec->lightlevel >> LIGHTSEGSHIFT)+extralight;
 
@@ -773,57 +832,65 @@ void R_DrawPlayerSprites (void)
 //
 // R_SortVisSprites
 //
-vissprite_t	vsprsortedhead;
+THREADLOCAL vissprite_t	vsprsortedhead;
 
 
 void R_SortVisSprites (void)
 {
-    int			i;
     int			count;
-    vissprite_t*	ds;
-    vissprite_t*	best;
-    vissprite_t		unsorted;
-    fixed_t		bestscale;
+    int			width;
+    int			lo;
+    int			mid;
+    int			hi;
+    int			i;
+    int			a;
+    int			b;
+    vissprite_t**	swap;
+
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
 
     count = vissprite_p - vissprites;
-	
-    unsorted.next = unsorted.prev = &unsorted;
 
     if (!count)
 	return;
-		
-    for (ds=vissprites ; ds<vissprite_p ; ds++)
-    {
-	ds->next = ds+1;
-	ds->prev = ds-1;
-    }
-    
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p-1)->next = &unsorted;
-    unsorted.prev = vissprite_p-1;
-    
-    // pull the vissprites out by scale
 
-    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
     for (i=0 ; i<count ; i++)
+	sortedsprites[i] = &vissprites[i];
+
+    // Bottom up merge sort by scale. It is stable, so sprites
+    //  of equal scale stay in the order they were projected in,
+    //  which is the order the old selection sort drew them in.
+    for (width=1 ; width<count ; width*=2)
     {
-	bestscale = INT_MAX;
-        best = unsorted.next;
-	for (ds=unsorted.next ; ds!= &unsorted ; ds=ds->next)
+	for (lo=0 ; lo<count ; lo+=width*2)
 	{
-	    if (ds->scale < bestscale)
+	    mid = lo+width < count ? lo+width : count;
+	    hi = mid+width < count ? mid+width : count;
+
+	    a = lo;
+	    b = mid;
+	    for (i=lo ; i<hi ; i++)
 	    {
-		bestscale = ds->scale;
-		best = ds;
+		if (a < mid
+		    && (b == hi || sortedsprites[a]->scale <= sortedsprites[b]->scale))
+		    mergesprites[i] = sortedsprites[a++];
+		else
+		    mergesprites[i] = sortedsprites[b++];
 	    }
 	}
-	best->next->prev = best->prev;
-	best->prev->next = best->next;
-	best->next = &vsprsortedhead;
-	best->prev = vsprsortedhead.prev;
-	vsprsortedhead.prev->next = best;
-	vsprsortedhead.prev = best;
+
+	swap = sortedsprites;
+	sortedsprites = mergesprites;
+	mergesprites = swap;
+    }
+
+    // link them up back to front
+    for (i=0 ; i<count ; i++)
+    {
+	sortedsprites[i]->next = &vsprsortedhead;
+	sortedsprites[i]->prev = vsprsortedhead.prev;
+	vsprsortedhead.prev->next = sortedsprites[i];
+	vsprsortedhead.prev = sortedsprites[i];
     }
 }
 
@@ -832,8 +899,8 @@ void R_SortVisSprites (void)
 //
 // R_DrawSprite
 //
-static short		clipbot[SCREENWIDTH];
-static short		cliptop[SCREENWIDTH];
+static THREADLOCAL short		clipbot[SCREENWIDTH];
+static THREADLOCAL short		cliptop[SCREENWIDTH];
 void R_DrawSprite (vissprite_t* spr)
 {
     drawseg_t*		ds;
@@ -843,6 +910,15 @@ void R_DrawSprite (vissprite_t* spr)
     fixed_t		scale;
     fixed_t		lowscale;
     int			silhouette;
+    int			b;
+    int			b1;
+    int			b2;
+    int			best;
+    int			pos[DSBLOCKS];
+
+    // Nothing to draw in this thread's strip
+    if (spr->colormap && (spr->x2 < stripx1 || spr->x1 > stripx2))
+	return;
 		
     for (x = spr->x1 ; x<=spr->x2 ; x++)
 	clipbot[x] = cliptop[x] = -2;
@@ -850,13 +926,33 @@ void R_DrawSprite (vissprite_t* spr)
     // Scan drawsegs from end to start for obscuring segs.
     // The first drawseg that has a greater scale
     //  is the clip seg.
-    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
+    // Only the blocks of columns under the sprite are scanned,
+    //  merged so each drawseg is still seen once, latest first.
+    b1 = spr->x1 >> DSBLOCKSHIFT;
+    b2 = spr->x2 >> DSBLOCKSHIFT;
+
+    for (b=b1 ; b<=b2 ; b++)
+	pos[b] = dsblocks[b].numsegs - 1;
+
+    for (;;)
     {
+	best = -1;
+	for (b=b1 ; b<=b2 ; b++)
+	    if (pos[b] >= 0 && dsblocks[b].segs[pos[b]] > best)
+		best = dsblocks[b].segs[pos[b]];
+
+	if (best < 0)
+	    break;
+
+	for (b=b1 ; b<=b2 ; b++)
+	    if (pos[b] >= 0 && dsblocks[b].segs[pos[b]] == best)
+		pos[b]--;
+
+	ds = drawsegs + best;
+
 	// determine if the drawseg obscures the sprite
 	if (ds->x1 > spr->x2
-	    || ds->x2 < spr->x1
-	    || (!ds->silhouette
-		&& !ds->maskedtexturecol) )
+	    || ds->x2 < spr->x1)
 	{
 	    // does not cover sprite
 	    continue;
@@ -59,6 +59,9 @@ static byte *dest_screen = NULL;
 
 int dirtybox[4]; 
 
+vrect_t dirtyrects[MAXDIRTYRECTS];
+int numdirtyrects;
+
 // haleyjd 08/28/10: clipping callback function for patches.
 // This is needed for Chocolate Strife, which clips patches to the screen.
 static vpatchclipfunc_t patchclip_callback = NULL;
@@ -68,15 +71,90 @@ static vpatchclipfunc_t patchclip_callback = NULL;
 // 
 void V_MarkRect(int x, int y, int width, int height) 
 { 
+    vrect_t *rect;
+    int x2, y2;
+    int i;
+
     // If we are temporarily using an alternate screen, do not 
     // affect the update box.
 
-    if (dest_screen == I_VideoBuffer)
+    if (dest_screen != I_VideoBuffer)
+    {
+        return;
+    }
+
+    x2 = x + width;
+    y2 = y + height;
+
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x2 > SCREENWIDTH)
+        x2 = SCREENWIDTH;
+    if (y2 > SCREENHEIGHT)
+        y2 = SCREENHEIGHT;
+
+    if (x >= x2 || y >= y2)
+    {
+        return;
+    }
+
+    M_AddToBox (dirtybox, x, y); 
+    M_AddToBox (dirtybox, x2-1, y2-1); 
+
+    // Absorb every rectangle this one touches, starting over
+    // each time as the union may reach rectangles passed over.
+
+    for (i = 0; i < numdirtyrects; ++i)
+    {
+        rect = &dirtyrects[i];
+
+        if (x <= rect->x + rect->width && rect->x <= x2
+         && y <= rect->y + rect->height && rect->y <= y2)
+        {
+            if (rect->x < x)
+                x = rect->x;
+            if (rect->y < y)
+                y = rect->y;
+            if (rect->x + rect->width > x2)
+                x2 = rect->x + rect->width;
+            if (rect->y + rect->height > y2)
+                y2 = rect->y + rect->height;
+
+            *rect = dirtyrects[--numdirtyrects];
+            i = -1;
+        }
+    }
+
+    // Out of rectangles, fall back to the union of them all.
+
+    if (numdirtyrects == MAXDIRTYRECTS)
     {
-        M_AddToBox (dirtybox, x, y); 
-        M_AddToBox (dirtybox, x + width-1, y + height-1); 
+        x = dirtybox[BOXLEFT];
+        y = dirtybox[BOXBOTTOM];
+        x2 = dirtybox[BOXRIGHT] + 1;
+        y2 = dirtybox[BOXTOP] + 1;
+        numdirtyrects = 0;
     }
+
+    rect = &dirtyrects[numdirtyrects++];
+    rect->x = x;
+    rect->y = y;
+    rect->width = x2 - x;
+    rect->height = y2 - y;
 } 
+
+
+//
+// V_ClearDirty
+// Forgets the rectangles marked, once they are on the screen.
+//
+void V_ClearDirty(void)
+{
+    M_ClearBox (dirtybox);
+    numdirtyrects = 0;
+}
  
 
 //
@@ -294,6 +372,8 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
         I_Error("Bad V_DrawTLPatch");
     }
 
+    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
@@ -342,6 +422,8 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
             return;
     }
 
+    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
@@ -393,6 +475,8 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
         I_Error("Bad V_DrawAltTLPatch");
     }
 
+    V_MarkRect(x, y, SHORT(patch->width), SHORT(patch->height));
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
 
@@ -444,6 +528,8 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
         I_Error("Bad V_DrawShadowedPatch");
     }
 
+    V_MarkRect(x, y, SHORT(patch->width) + 2, SHORT(patch->height) + 2);
+
     col = 0;
     desttop = dest_screen + y * SCREENWIDTH + x;
     desttop2 = dest_screen + (y + 2) * SCREENWIDTH + x + 2;
@@ -531,6 +617,8 @@ void V_DrawFilledBox(int x, int y, int w, int h, int c)
     uint8_t *buf, *buf1;
     int x1, y1;
 
+    V_MarkRect(x, y, w, h);
+
     buf = I_VideoBuffer + SCREENWIDTH * y + x;
 
     for (y1 = 0; y1 < h; ++y1)
@@ -551,6 +639,8 @@ void V_DrawHorizLine(int x, int y, int w, int c)
     uint8_t *buf;
     int x1;
 
+    V_MarkRect(x, y, w, 1);
+
     buf = I_VideoBuffer + SCREENWIDTH * y + x;
 
     for (x1 = 0; x1 < w; ++x1)
@@ -564,6 +654,8 @@ void V_DrawVertLine(int x, int y, int h, int c)
     uint8_t *buf;
     int y1;
 
+    V_MarkRect(x, y, 1, h);
+
     buf = I_VideoBuffer + SCREENWIDTH * y + x;
 
     for (y1 = 0; y1 < h; ++y1)
@@ -588,6 +680,7 @@ void V_DrawBox(int x, int y, int w, int h, int c)
  
 void V_DrawRawScreen(byte *raw)
 {
+    V_MarkRect(0, 0, SCREENWIDTH, SCREENHEIGHT);
     memcpy(dest_screen, raw, SCREENWIDTH * SCREENHEIGHT);
 }
 
@@ -596,9 +689,10 @@ void V_DrawRawScreen(byte *raw)
 // 
 void V_Init (void) 
 { 
-    // no-op!
     // There used to be separate screens that could be drawn to; these are
     // now handled in the upper layers.
+
+    V_ClearDirty();
 }
 
 // Set the buffer that the code draws to.
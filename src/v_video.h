@@ -36,6 +36,22 @@
 
 extern int dirtybox[4];
 
+// Rectangles of the screen drawn since the last V_ClearDirty,
+// merged where they touch. dirtybox holds their union.
+
+#define MAXDIRTYRECTS 8
+
+typedef struct
+{
+    int x;
+    int y;
+    int width;
+    int height;
+} vrect_t;
+
+extern vrect_t dirtyrects[MAXDIRTYRECTS];
+extern int numdirtyrects;
+
 extern byte *tinttable;
 
 // haleyjd 08/28/10: implemented for Strife support
@@ -67,6 +83,7 @@ void V_DrawPatchDirect(int x, int y, patch_t *patch);
 void V_DrawBlock(int x, int y, int width, int height, byte *src);
 
 void V_MarkRect(int x, int y, int width, int height);
+void V_ClearDirty(void);
 
 void V_DrawFilledBox(int x, int y, int w, int h, int c);
 void V_DrawHorizLine(int x, int y, int w, int c);
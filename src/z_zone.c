@@ -64,6 +64,24 @@ typedef struct
 memzone_t*	mainzone;
 
 
+//
+// POOLS
+//
+// Each block of a pool follows a header naming its pool,
+//  which holds the link to the next free block while free,
+//  so the block itself reads the same after it is freed.
+//
+#define POOLBLOCKS	64
+
+typedef union poolhead_u
+{
+    zpool_t*		pool;
+    union poolhead_u*	next;
+} poolhead_t;
+
+static zpool_t*	pools;
+
+
 
 //
 // Z_ClearZone
@@ -291,6 +309,84 @@ Z_Malloc
 
 
 
+//
+// Z_ClearPools
+// Forgets the free blocks of pools whose zone blocks are gone.
+//
+static void Z_ClearPools (int lowtag, int hightag)
+{
+    zpool_t*	pool;
+
+    for (pool = pools ; pool ; pool = pool->next)
+    {
+	if (pool->tag >= lowtag && pool->tag <= hightag)
+	    pool->free = NULL;
+    }
+}
+
+
+
+//
+// Z_PoolMalloc
+//
+void* Z_PoolMalloc (zpool_t* pool)
+{
+    int			stride;
+    int			i;
+    byte*		blocks;
+    poolhead_t*		head;
+
+    if (!pool->free)
+    {
+	if (pool->tag >= PU_PURGELEVEL)
+	    I_Error ("Z_PoolMalloc: a pool can not be purgable");
+
+	if (!pool->registered)
+	{
+	    pool->next = pools;
+	    pools = pool;
+	    pool->registered = true;
+	}
+
+	// Carve a zone block into free blocks, listed
+	//  so they are handed out in address order.
+	stride = (sizeof(poolhead_t) + pool->size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
+	blocks = Z_Malloc (POOLBLOCKS * stride, pool->tag, NULL);
+
+	for (i = POOLBLOCKS-1 ; i >= 0 ; i--)
+	{
+	    head = (poolhead_t *) (blocks + i*stride);
+	    head->next = pool->free;
+	    pool->free = head;
+	}
+    }
+
+    head = pool->free;
+    pool->free = head->next;
+    head->pool = pool;
+
+    return head + 1;
+}
+
+
+
+//
+// Z_PoolFree
+//
+void Z_PoolFree (void* ptr)
+{
+    poolhead_t*	head;
+    zpool_t*	pool;
+
+    head = (poolhead_t *) ptr - 1;
+    pool = head->pool;
+
+    head->next = pool->free;
+    pool->free = head;
+}
+
+
+
 //
 // Z_FreeTags
 //
@@ -316,6 +412,8 @@ Z_FreeTags
 	if (block->tag >= lowtag && block->tag <= hightag)
 	    Z_Free ( (byte *)block+sizeof(memblock_t));
     }
+
+    Z_ClearPools (lowtag, hightag);
 }
 
 
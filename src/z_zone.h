@@ -26,6 +26,8 @@
 
 #include <stdio.h>
 
+#include "doomtype.h"
+
 //
 // ZONE MEMORY
 // PU - purge tags.
@@ -62,6 +64,26 @@ void    Z_ChangeUser(void *ptr, void **user);
 int     Z_FreeMemory (void);
 unsigned int Z_ZoneSize(void);
 
+//
+// Pools of blocks of one size, carved out of zone blocks with the
+// pool's tag, each freed in constant time to a list it is reused
+// from. Z_FreeTags empties the pools along with the zone blocks.
+//
+
+typedef struct zpool_s
+{
+    int                 size;   // of a block, as asked for
+    int                 tag;    // below PU_PURGELEVEL
+    void*               free;
+    boolean             registered;
+    struct zpool_s*     next;   // pools Z_FreeTags knows about
+} zpool_t;
+
+#define Z_POOL(type, tag) { sizeof(type), (tag), NULL, false, NULL }
+
+void*   Z_PoolMalloc (zpool_t *pool);
+void    Z_PoolFree (void *ptr);
+
 //
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.